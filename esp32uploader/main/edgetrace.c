@@ -0,0 +1,120 @@
+#include <string.h>
+#include "edgetrace.h"
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t edgetrace_write_header(const edgetrace_header_t *header, uint8_t *dest) {
+    memcpy(dest, EDGETRACE_MAGIC, 4);
+    dest[4] = EDGETRACE_VERSION;
+    dest[5] = header->channel;
+    dest[6] = header->first_level;
+    dest[7] = 0;
+    put_le32(dest + 8, header->resolution_hz);
+    put_le32(dest + 12, header->time);
+    return EDGETRACE_HEADER_LEN;
+}
+
+int edgetrace_read_header(const uint8_t *src, size_t len, edgetrace_header_t *header) {
+    if (len < EDGETRACE_HEADER_LEN || memcmp(src, EDGETRACE_MAGIC, 4) || src[4] != EDGETRACE_VERSION) return -1;
+
+    header->channel = src[5];
+    header->first_level = src[6];
+    header->resolution_hz = le32(src + 8);
+    header->time = le32(src + 12);
+    return header->resolution_hz ? 0 : -1;
+}
+
+static size_t put_varint(uint8_t *dest, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        dest[n++] = v | 0x80;
+        v >>= 7;
+    }
+    dest[n++] = v;
+    return n;
+}
+
+void edgetrace_writer_init(edgetrace_writer_t *w, uint8_t first_level) {
+    w->level = first_level;
+    w->ticks = 0;
+    w->broken = 0;
+}
+
+size_t edgetrace_writer_flush(edgetrace_writer_t *w, uint8_t *dest) {
+    if (!w->ticks) return 0;
+    size_t n = put_varint(dest, w->ticks);
+    w->ticks = 0;
+    return n;
+}
+
+size_t edgetrace_writer_add(edgetrace_writer_t *w, uint8_t level, uint32_t ticks, uint8_t *dest) {
+    size_t n = 0;
+
+    if (!ticks) return 0;
+    level = level ? 1 : 0;
+
+    if (w->broken) {
+        n = edgetrace_writer_flush(w, dest);
+        dest[n++] = 0;
+        dest[n++] = level;
+        w->level = level;
+        w->broken = 0;
+    } else if (level != w->level) {
+        n = edgetrace_writer_flush(w, dest);
+        w->level = level;
+    }
+
+    // delka useku se nevejde do uint32 - rozdelime ho prerusenim se stejnou urovni
+    if (w->ticks > UINT32_MAX - ticks) {
+        n += edgetrace_writer_flush(w, dest + n);
+        dest[n++] = 0;
+        dest[n++] = level;
+    }
+    w->ticks += ticks;
+    return n;
+}
+
+void edgetrace_writer_break(edgetrace_writer_t *w) {
+    w->broken = 1;
+}
+
+void edgetrace_reader_init(edgetrace_reader_t *r, const uint8_t *body, size_t len, uint8_t first_level) {
+    r->p = body;
+    r->end = body + len;
+    r->level = first_level ? 1 : 0;
+}
+
+edgetrace_item_t edgetrace_next(edgetrace_reader_t *r, uint8_t *level, uint32_t *ticks) {
+    uint32_t v = 0;
+    int shift = 0;
+
+    if (r->p >= r->end) return EDGETRACE_END;
+
+    do {
+        if (r->p >= r->end || shift > 28) return EDGETRACE_ERROR;
+        v |= (uint32_t)(*r->p & 0x7F) << shift;
+        shift += 7;
+    } while (*r->p++ & 0x80);
+
+    if (!v) {
+        if (r->p >= r->end) return EDGETRACE_ERROR;
+        r->level = *r->p++ ? 1 : 0;
+        *level = r->level;
+        *ticks = 0;
+        return EDGETRACE_BREAK;
+    }
+
+    *level = r->level;
+    *ticks = v;
+    r->level ^= 1;
+    return EDGETRACE_SPAN;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Zaznam hran z prijimace (IR nebo 433 MHz) - bez zavislosti na ESP-IDF, stejne jako irframe.c,
+// aby zaznam z brany (socedge.c) sel prehrat na hostu (sim/edgereplay).
+//
+// Hlavicka EDGETRACE_HEADER_LEN B, little endian:
+//   "EDGT" | verze | kanal (EDGETRACE_IR / EDGETRACE_RF) | uroven prvniho useku | 0
+//   | resolution_hz (u32) | unix cas zacatku (u32)
+// Telo: delky useku se stejnou urovni v tickach jako varint (7 bitu na byte, nejnizsi prvni),
+// urovne se stridaji. Delka 0 je preruseni (ztracena data) - nasleduje byte s urovni dalsiho useku.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EDGETRACE_MAGIC         "EDGT"
+#define EDGETRACE_VERSION       1
+#define EDGETRACE_HEADER_LEN    16
+#define EDGETRACE_MAX_ITEM_LEN  5       // varint uint32
+
+#define EDGETRACE_IR            0       // vystup IR prijimace - 0 je nosna
+#define EDGETRACE_RF            1       // datovy vystup prijimace 433 MHz
+
+typedef struct {
+    uint8_t channel;
+    uint8_t first_level;
+    uint32_t resolution_hz;
+    uint32_t time;
+} edgetrace_header_t;
+
+typedef struct {
+    uint8_t level;          // uroven rozpracovaneho useku
+    uint32_t ticks;         // jeho dosavadni delka, 0 - zadny
+    uint8_t broken;         // pred dalsim usekem zapsat preruseni
+} edgetrace_writer_t;
+
+typedef enum {
+    EDGETRACE_END,
+    EDGETRACE_SPAN,
+    EDGETRACE_BREAK,
+    EDGETRACE_ERROR,
+} edgetrace_item_t;
+
+typedef struct {
+    const uint8_t *p, *end;
+    uint8_t level;
+} edgetrace_reader_t;
+
+size_t edgetrace_write_header(const edgetrace_header_t *header, uint8_t *dest);
+// vraci 0 nebo -1 pro neznamy format
+int edgetrace_read_header(const uint8_t *src, size_t len, edgetrace_header_t *header);
+
+// Zapis: useky se stejnou urovni se spoji, do dest se zapise nejvyse 2 * EDGETRACE_MAX_ITEM_LEN B.
+// Vraci pocet zapsanych bytu.
+void edgetrace_writer_init(edgetrace_writer_t *w, uint8_t first_level);
+size_t edgetrace_writer_add(edgetrace_writer_t *w, uint8_t level, uint32_t ticks, uint8_t *dest);
+void edgetrace_writer_break(edgetrace_writer_t *w);
+size_t edgetrace_writer_flush(edgetrace_writer_t *w, uint8_t *dest);
+
+// Cteni tela za hlavickou
+void edgetrace_reader_init(edgetrace_reader_t *r, const uint8_t *body, size_t len, uint8_t first_level);
+edgetrace_item_t edgetrace_next(edgetrace_reader_t *r, uint8_t *level, uint32_t *ticks);
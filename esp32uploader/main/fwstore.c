@@ -0,0 +1,152 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "irframe.h"
+#include "fwstore.h"
+
+#define TAG "FWSTORE"
+
+#define SLOT_MAGIC 0x32535746  // "FWS2"
+
+typedef struct {
+    uint32_t magic;
+    fwstore_info_t info;
+    uint8_t used[IRFRAME_PAGE_MAP_LEN];
+    uint32_t crc;           // CRC32 obrazu
+} slot_hdr_t;
+
+static const esp_partition_t *_part;
+static SemaphoreHandle_t _lock;
+static size_t _slot_count;
+
+static esp_err_t read_hdr(size_t slot, slot_hdr_t *hdr) {
+    esp_err_t err = esp_partition_read(_part, slot * FWSTORE_SLOT_SIZE, hdr, sizeof(*hdr));
+    if (err != ESP_OK) return err;
+    return hdr->magic == SLOT_MAGIC && hdr->info.len <= IRFRAME_FLASH_LIMIT ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static int find_slot(uint8_t sensor_id) {
+    slot_hdr_t hdr;
+    for (size_t i = 0; i < _slot_count; i++) {
+        if (read_hdr(i, &hdr) == ESP_OK && hdr.info.sensor_id == sensor_id) return i;
+    }
+    return -1;
+}
+
+static int find_free_slot(void) {
+    slot_hdr_t hdr;
+    for (size_t i = 0; i < _slot_count; i++) {
+        if (read_hdr(i, &hdr) != ESP_OK) return i;
+    }
+    return -1;
+}
+
+esp_err_t fwstore_init(void) {
+    _part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FWSTORE_PARTITION_LABEL);
+    if (!_part) {
+        ESP_LOGE(TAG, "Oddil %s nenalezen", FWSTORE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    _slot_count = _part->size / FWSTORE_SLOT_SIZE;
+    _lock = xSemaphoreCreateMutex();
+    if (!_lock) return ESP_ERR_NO_MEM;
+
+    ESP_LOGI(TAG, "%u slotu", (unsigned)_slot_count);
+    return ESP_OK;
+}
+
+esp_err_t fwstore_put(uint8_t sensor_id, uint8_t version, const uint8_t *image, size_t len, const uint8_t *used) {
+    if (!_part) return ESP_ERR_INVALID_STATE;
+    if (!len || len > IRFRAME_FLASH_LIMIT) return ESP_ERR_INVALID_SIZE;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+
+    int slot = find_slot(sensor_id);
+    if (slot < 0) slot = find_free_slot();
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (slot >= 0) {
+        slot_hdr_t hdr = {
+            .magic = SLOT_MAGIC,
+            .info = {
+                .sensor_id = sensor_id,
+                .version = version,
+                .len = len,
+                .time = time(NULL),
+            },
+            .crc = esp_rom_crc32_le(0, image, len),
+        };
+        if (used) memcpy(hdr.used, used, sizeof(hdr.used));
+        else memset(hdr.used, 0xFF, sizeof(hdr.used));
+        size_t base = slot * FWSTORE_SLOT_SIZE;
+
+        err = esp_partition_erase_range(_part, base, FWSTORE_SLOT_SIZE);
+        if (err == ESP_OK) err = esp_partition_write(_part, base + sizeof(hdr), image, len);
+        if (err == ESP_OK) err = esp_partition_write(_part, base, &hdr, sizeof(hdr));
+    }
+
+    xSemaphoreGive(_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Senzor %d: verze 0x%02X, %u B ve slotu %d", sensor_id, version, (unsigned)len, slot);
+    } else {
+        ESP_LOGE(TAG, "Senzor %d: ulozeni selhalo: %s", sensor_id, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t fwstore_get(uint8_t sensor_id, fwstore_info_t *info, uint8_t *image, uint8_t *used) {
+    slot_hdr_t hdr;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (!_part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+
+    int slot = find_slot(sensor_id);
+    if (slot >= 0 && read_hdr(slot, &hdr) == ESP_OK) {
+        err = esp_partition_read(_part, slot * FWSTORE_SLOT_SIZE + sizeof(hdr), image, hdr.info.len);
+        if (err == ESP_OK && esp_rom_crc32_le(0, image, hdr.info.len) != hdr.crc) err = ESP_ERR_INVALID_CRC;
+        if (err == ESP_OK) {
+            *info = hdr.info;
+            memcpy(used, hdr.used, sizeof(hdr.used));
+        }
+    }
+
+    xSemaphoreGive(_lock);
+    return err;
+}
+
+esp_err_t fwstore_delete(uint8_t sensor_id) {
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (!_part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    int slot = find_slot(sensor_id);
+    if (slot >= 0) err = esp_partition_erase_range(_part, slot * FWSTORE_SLOT_SIZE, FWSTORE_SLOT_SIZE);
+    xSemaphoreGive(_lock);
+    return err;
+}
+
+int fwstore_list(void (*cb)(const fwstore_info_t *info, void *ctx), void *ctx) {
+    slot_hdr_t hdr;
+    int count = 0;
+
+    if (!_part) return 0;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (size_t i = 0; i < _slot_count; i++) {
+        if (read_hdr(i, &hdr) != ESP_OK) continue;
+        cb(&hdr.info, ctx);
+        count++;
+    }
+    xSemaphoreGive(_lock);
+    return count;
+}
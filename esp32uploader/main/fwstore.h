@@ -0,0 +1,29 @@
+#pragma once
+
+// Obrazy firmware senzoru v oddilu "fwstore" (partitions.csv) - jeden slot na senzor.
+// Obraz je binarni obsah flash od adresy 0 (avr-objcopy -O binary), nejvyse IRFRAME_FLASH_LIMIT,
+// s bitmapou stranek k vysilani (irframe_page_used).
+// Hlavicka slotu se zapisuje az po datech, takze preruseny zapis slot nezneplatni.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define FWSTORE_PARTITION_LABEL "fwstore"
+#define FWSTORE_SLOT_SIZE       0x2000
+
+typedef struct {
+    uint8_t sensor_id;
+    uint8_t version;        // FW_VERSION - senzor ji posila ve zprave
+    uint16_t len;
+    uint32_t time;          // kdy byl obraz nahran
+} fwstore_info_t;
+
+esp_err_t fwstore_init(void);
+// used == NULL - binarni obraz, vysilaji se vsechny stranky
+esp_err_t fwstore_put(uint8_t sensor_id, uint8_t version, const uint8_t *image, size_t len, const uint8_t *used);
+// image musi mit misto na IRFRAME_FLASH_LIMIT bytu, used na IRFRAME_PAGE_MAP_LEN
+esp_err_t fwstore_get(uint8_t sensor_id, fwstore_info_t *info, uint8_t *image, uint8_t *used);
+esp_err_t fwstore_delete(uint8_t sensor_id);
+// projde ulozene obrazy, vraci jejich pocet
+int fwstore_list(void (*cb)(const fwstore_info_t *info, void *ctx), void *ctx);
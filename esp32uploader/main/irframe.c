@@ -0,0 +1,221 @@
+#include <string.h>
+#include "irframe.h"
+
+const uint8_t irframe_start_symbol[IRFRAME_START_LEN] = {
+    IRFRAME_PREAMBLE_BYTE, IRFRAME_PREAMBLE_BYTE, 'F', 'U'
+};
+
+const uint8_t irframe_start_symbol_nrz[IRFRAME_START_LEN] = {
+    IRFRAME_PREAMBLE_BYTE, IRFRAME_PREAMBLE_BYTE, 'F', 'N'
+};
+
+static const uint8_t nimbble_symbols[] =
+{
+    0xd, 0xe, 0x13, 0x15, 0x16, 0x19, 0x1a, 0x1c,
+    0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34
+};
+
+// stejne jako calc_crc v bootloader.S (Dallas/Maxim, poly 0x8C)
+uint8_t irframe_crc8(uint8_t crc, uint8_t data) {
+    crc ^= data;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+    return crc;
+}
+
+size_t irframe_nibblify(const uint8_t *src, size_t srclen, uint8_t *dest, size_t destlen) {
+    size_t dest_ix = 0;
+
+    for (size_t i = 0; i < srclen; i += 2) {
+        uint8_t a = nimbble_symbols[src[i] >> 4];
+        uint8_t b = nimbble_symbols[src[i] & 0x0f];
+        uint8_t c = 0;
+        uint8_t d = 0;
+        if (i + 1 < srclen) {
+            c = nimbble_symbols[src[i + 1] >> 4];
+            d = nimbble_symbols[src[i + 1] & 0x0f];
+        }
+
+        uint8_t x = a << 2 | b >> 4;
+        uint8_t y = b << 4 | c >> 2;
+        uint8_t z = c << 6 | d;
+
+        if (destlen - dest_ix < 3) return 0;
+
+        dest[dest_ix++] = x;
+        dest[dest_ix++] = y;
+        dest[dest_ix++] = z;
+    }
+    return dest_ix;
+}
+
+uint8_t irframe_scrambler_next(uint8_t *state, int lsb_first) {
+    uint8_t ks = 0;
+
+    // Galoisuv LFSR jako descramble_loop v bootloader.S - vystupem je horni bit stavu
+    for (int i = 0; i < 8; i++) {
+        uint8_t bit = *state >> 7;
+        *state <<= 1;
+        if (bit) *state ^= IRFRAME_SCRAMBLER_POLY;
+        ks = lsb_first ? ks >> 1 | bit << 7 : ks << 1 | bit;
+    }
+    return ks;
+}
+
+void irframe_scramble(uint8_t *state, uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) buf[i] ^= irframe_scrambler_next(state, 0);
+}
+
+void irframe_build_page(uint16_t addr, uint8_t index, const uint8_t *page, uint8_t *frame) {
+    uint8_t crc = 0;
+    size_t len = 0;
+
+    frame[len++] = addr >> 8;
+    frame[len++] = addr & 0xFF;
+    frame[len++] = index;
+    memcpy(frame + len, page, IRFRAME_PAGE_SIZE);
+    len += IRFRAME_PAGE_SIZE;
+
+    for (size_t i = 0; i < len; i++) {
+        crc = irframe_crc8(crc, frame[i]);
+    }
+    frame[len] = crc;
+}
+
+size_t irframe_encode_page(uint16_t addr, uint8_t index, const uint8_t *page, irframe_code_t code,
+                           uint8_t *dest, size_t destlen) {
+    uint8_t frame[IRFRAME_FRAME_LEN];
+    size_t head = IRFRAME_PREAMBLE_LEN + IRFRAME_START_LEN;
+
+    if (destlen < (code == IRFRAME_CODE_NRZ ? IRFRAME_PAGE_TX_NRZ_LEN : IRFRAME_PAGE_TX_LEN)) return 0;
+
+    memset(dest, IRFRAME_PREAMBLE_BYTE, IRFRAME_PREAMBLE_LEN);
+    memcpy(dest + IRFRAME_PREAMBLE_LEN, code == IRFRAME_CODE_NRZ ? irframe_start_symbol_nrz : irframe_start_symbol,
+           IRFRAME_START_LEN);
+
+    irframe_build_page(addr, index, page, frame);
+
+    if (code == IRFRAME_CODE_NRZ) {
+        uint8_t state = IRFRAME_SCRAMBLER_SEED;
+        memcpy(dest + head, frame, sizeof(frame));
+        irframe_scramble(&state, dest + head, sizeof(frame));
+        return head + sizeof(frame);
+    }
+
+    size_t n = irframe_nibblify(frame, sizeof(frame), dest + head, destlen - head);
+    return n ? head + n : 0;
+}
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static int hex_byte(const char *s) {
+    int hi = hex_nibble(s[0]), lo = hex_nibble(s[1]);
+    return hi < 0 || lo < 0 ? -1 : hi << 4 | lo;
+}
+
+void irframe_hex_init(irframe_hex_t *hex, uint8_t *image, size_t image_len) {
+    memset(hex, 0, sizeof(*hex));
+    hex->image = image;
+    hex->image_len = image_len;
+}
+
+static irframe_hex_status_t hex_record(irframe_hex_t *hex) {
+    const char *p = hex->line;
+    size_t n = hex->line_len;
+    uint8_t rec[4 + 255 + 1];
+
+    while (n && (p[n - 1] == '\r' || p[n - 1] == ' ' || p[n - 1] == '\t')) n--;
+    while (n && (*p == ' ' || *p == '\t')) {
+        p++;
+        n--;
+    }
+    if (!n) return IRFRAME_HEX_MORE;                    // prazdny radek
+    if (*p != ':' || n < 11 || !(n & 1)) return IRFRAME_HEX_ERROR;
+
+    size_t count = (n - 1) / 2;
+    uint8_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        int b = hex_byte(p + 1 + 2 * i);
+        if (b < 0) return IRFRAME_HEX_ERROR;
+        rec[i] = b;
+        sum += b;
+    }
+    if (sum || count != 5u + rec[0]) return IRFRAME_HEX_ERROR;
+
+    uint8_t len = rec[0], type = rec[3];
+    const uint8_t *data = rec + 4;
+
+    switch (type) {
+        case 0x00: {
+            uint32_t addr = hex->base + (rec[1] << 8 | rec[2]);
+            if (addr + len > hex->image_len) return IRFRAME_HEX_ERROR;
+            memcpy(hex->image + addr, data, len);
+            if (addr + len > hex->end) hex->end = addr + len;
+            // stranky nad IRFRAME_FLASH_LIMIT (bootloader v sim/irloopback) se nevysilaji
+            for (uint32_t p = addr / IRFRAME_PAGE_SIZE; len && p * IRFRAME_PAGE_SIZE < addr + len; p++) {
+                if (p < IRFRAME_PAGE_MAP_LEN * 8) hex->used[p / 8] |= 1 << (p & 7);
+            }
+            return IRFRAME_HEX_MORE;
+        }
+        case 0x01:
+            return IRFRAME_HEX_DONE;
+        case 0x02:
+            if (len != 2) return IRFRAME_HEX_ERROR;
+            hex->base = (uint32_t)(data[0] << 8 | data[1]) << 4;
+            return IRFRAME_HEX_MORE;
+        case 0x04:
+            if (len != 2) return IRFRAME_HEX_ERROR;
+            hex->base = (uint32_t)(data[0] << 8 | data[1]) << 16;
+            return IRFRAME_HEX_MORE;
+        default:
+            return IRFRAME_HEX_MORE;                    // 03, 05 - startovni adresa nas nezajima
+    }
+}
+
+irframe_hex_status_t irframe_hex_feed(irframe_hex_t *hex, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len && hex->status == IRFRAME_HEX_MORE; i++) {
+        if (data[i] != '\n') {
+            if (hex->line_len == IRFRAME_HEX_LINE_MAX) {
+                hex->status = IRFRAME_HEX_ERROR;
+                break;
+            }
+            hex->line[hex->line_len++] = data[i];
+            continue;
+        }
+        hex->line_no++;
+        hex->status = hex_record(hex);
+        hex->line_len = 0;
+    }
+    return hex->status;
+}
+
+irframe_hex_status_t irframe_hex_finish(irframe_hex_t *hex) {
+    if (hex->status == IRFRAME_HEX_MORE && hex->line_len) {
+        hex->line_no++;
+        hex->status = hex_record(hex);
+        hex->line_len = 0;
+    }
+    // bez zaznamu 01 je soubor nejspis useknuty - nic nenahravame
+    if (hex->status == IRFRAME_HEX_MORE) hex->status = IRFRAME_HEX_ERROR;
+    return hex->status;
+}
+
+int irframe_page_used(const uint8_t *used, size_t page) {
+    if (!used) return 1;
+    return page < IRFRAME_PAGE_MAP_LEN * 8 && (used[page / 8] >> (page & 7) & 1);
+}
+
+size_t irframe_pages_to_send(const uint8_t *used, size_t end) {
+    size_t pages = (end + IRFRAME_PAGE_SIZE - 1) / IRFRAME_PAGE_SIZE;
+    size_t count = 0;
+    for (size_t p = 0; p < pages; p++) {
+        if (irframe_page_used(used, p)) count++;
+    }
+    return count;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Kodovani dat pro IR bootloader (bootloader/bootloader.S) - bez zavislosti na ESP-IDF,
+// aby slo stejne kodovani prelozit i na hostu (sim/irloopback).
+//
+// Vysilani jedne stranky: preambule 0xCC.., START symbol a ramec: ZH, ZL, klesajici index stranky,
+// 64 B dat, CRC8. Kodovani ramce urcuje START symbol:
+//   "FU" (0x4655) - 4b6b (RH_ASK), 12 bitu na byte - umi kazdy bootloader
+//   "FN" (0x464E) - NRZ, 8 bitu na byte XOR s LFSR x^8+x^4+x^3+x^2+1 od IRFRAME_SCRAMBLER_SEED;
+//                   bootloader, ktery ho umi, posila beacon 'N' misto 'R'
+// Stejny skrambler pouziva i example/motionrx/sender.S (RF), tam se bity vysilaji LSB first.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IRFRAME_PREAMBLE_BYTE   0xCC
+#define IRFRAME_PREAMBLE_LEN    12      // (12*x - 4) / 8 bytu synchronizace
+#define IRFRAME_START_LEN       4       // START symbol posila klient primo - bez kodovani
+#define IRFRAME_PAGE_SIZE       64
+#define IRFRAME_FRAME_LEN       (3 + IRFRAME_PAGE_SIZE + 1)
+#define IRFRAME_NIBBLIFIED_LEN(n) ((((n) + 1) / 2) * 3)
+#define IRFRAME_PAGE_TX_LEN     (IRFRAME_PREAMBLE_LEN + IRFRAME_START_LEN + IRFRAME_NIBBLIFIED_LEN(IRFRAME_FRAME_LEN))
+#define IRFRAME_PAGE_TX_NRZ_LEN (IRFRAME_PREAMBLE_LEN + IRFRAME_START_LEN + IRFRAME_FRAME_LEN)
+
+#define IRFRAME_SCRAMBLER_POLY  0x1D
+#define IRFRAME_SCRAMBLER_SEED  0xFF
+
+typedef enum {
+    IRFRAME_CODE_4B6B,
+    IRFRAME_CODE_NRZ,
+} irframe_code_t;
+
+// bootloader zacina na 0x1D00 - vyse nesmime zapisovat
+#define IRFRAME_FLASH_LIMIT     0x1D00
+// bitmapa stranek pod IRFRAME_FLASH_LIMIT - bit (p & 7) v bytu p / 8
+#define IRFRAME_PAGE_MAP_LEN    ((IRFRAME_FLASH_LIMIT / IRFRAME_PAGE_SIZE + 7) / 8)
+
+extern const uint8_t irframe_start_symbol[IRFRAME_START_LEN];
+extern const uint8_t irframe_start_symbol_nrz[IRFRAME_START_LEN];
+
+uint8_t irframe_crc8(uint8_t crc, uint8_t data);
+
+// prevede dvojice bytu na 3 byty 6bitovych symbolu, vraci delku nebo 0 pri nedostatku mista
+size_t irframe_nibblify(const uint8_t *src, size_t srclen, uint8_t *dest, size_t destlen);
+
+// dalsi byte keystreamu NRZ - prvni vysilany bit je v MSB (IR), s lsb_first v LSB (RF)
+uint8_t irframe_scrambler_next(uint8_t *state, int lsb_first);
+// XOR bytu vysilanych MSB first s keystreamem - state mezi volanimi pokracuje
+void irframe_scramble(uint8_t *state, uint8_t *buf, size_t len);
+
+// sestavi ramec stranky (bez START symbolu) do frame[IRFRAME_FRAME_LEN]
+void irframe_build_page(uint16_t addr, uint8_t index, const uint8_t *page, uint8_t *frame);
+
+// kompletni vysilani jedne stranky tak, jak ho posila socirtx do RMT - vraci delku nebo 0
+size_t irframe_encode_page(uint16_t addr, uint8_t index, const uint8_t *page, irframe_code_t code,
+                           uint8_t *dest, size_t destlen);
+
+// Postupne cteni Intel HEX (avr-objcopy -O ihex) - data muzou prijit po libovolnych kusech.
+// Zapisuje jen do image[0 .. image_len), ostatni byty nemeni (pred pouzitim vyplnit 0xFF).
+// Do 'used' si znaci stranky, do kterych zapsal nejaky datovy zaznam.
+
+#define IRFRAME_HEX_LINE_MAX    (1 + 2 * (4 + 255 + 1))
+
+typedef enum {
+    IRFRAME_HEX_MORE = 0,       // cekame na dalsi data
+    IRFRAME_HEX_DONE,           // zaznam 01 - konec souboru
+    IRFRAME_HEX_ERROR,          // neplatny radek, checksum nebo adresa mimo image
+} irframe_hex_status_t;
+
+typedef struct {
+    uint8_t *image;
+    size_t image_len;
+    size_t end;                 // nejvyssi zapsana adresa + 1
+    uint8_t used[IRFRAME_PAGE_MAP_LEN];
+    uint32_t base;              // z rozsirenych adres (02, 04)
+    uint32_t line_no;
+    size_t line_len;
+    irframe_hex_status_t status;
+    char line[IRFRAME_HEX_LINE_MAX + 1];
+} irframe_hex_t;
+
+void irframe_hex_init(irframe_hex_t *hex, uint8_t *image, size_t image_len);
+irframe_hex_status_t irframe_hex_feed(irframe_hex_t *hex, const uint8_t *data, size_t len);
+// konec vstupu - zpracuje posledni radek bez '\n', bez zaznamu 01 vraci chybu
+irframe_hex_status_t irframe_hex_finish(irframe_hex_t *hex);
+
+// Stranka, do ktere HEX nic nezapsal, se neposila - bootloader ji nechava byt. Stranku vyplnenou
+// 0xFF zaznamem poslat musime: bootloader maze jen prijate stranky, zustal by v ni stary program.
+// used == NULL (binarni obraz) - posilaji se vsechny stranky.
+int irframe_page_used(const uint8_t *used, size_t page);
+// pocet stranek k odeslani - prvni odeslana stranka ma tento index
+size_t irframe_pages_to_send(const uint8_t *used, size_t end);
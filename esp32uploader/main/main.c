@@ -5,10 +5,20 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_wifi.h"
+#include "esp_netif_sntp.h"
 #include "wifi.h"
 #include "socota.h"
 #include "socirtx.h"
 #include "socirnec.h"
+#include "tsdb.h"
+#include "soctsdb.h"
+#include "metrics.h"
+#include "util.h"
+#include "fwstore.h"
+#include "rollout.h"
+#include "socfleet.h"
+#include "socrf.h"
+#include "socedge.h"
 
 #define TAG "MAIN"
 
@@ -17,16 +27,38 @@ void app_main(void) {
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+    // pripojeni bezi na pozadi, sluzby otevrou sokety az s IP (boot_to_listen_ms v metrikach)
     init_wifi_radio();
     connect_wifi();
 
+    // cas pro zaznamy v tsdb - bez SNTP se pocita od startu
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG("pool.ntp.org");
+    esp_netif_sntp_init(&sntp_config);
+
+    // Citace a histogramy - "echo | ncat esp 9996"
+    metrics_socket_server_init(9996);
+
     init_ota_socket_server();
 
+    // Casova rada zprav ze senzoru - dotazy "<sensor_id> <od> [do]"
+    if (tsdb_init() == ESP_OK) tsdb_socket_server_init(9997);
+
+    ir_tx_lock_init();
+
     // Zapis bitbangem do IRM-3638T - pro bootloader
     irtx_socket_writer_init(2000, 1, 9999);
 
     // Zapis bitbangem do IRM-3638T - pro komunikaci ala NEC
     irnec_socket_writer_init(2000, 1, 9998);
 
+    // Zpravy ze senzoru od externiho 433 MHz prijimace - hex radky, viz socrf.h
+    rf_socket_server_init(9994);
+
+    // Obrazy firmware senzoru a fronta aktualizaci pres IR - viz socfleet.h
+    if (fwstore_init() == ESP_OK && rollout_init() == ESP_OK) fleet_socket_server_init(9995);
+
+    // Zaznam hran z IR / 433 MHz prijimace pro sim/edgereplay - "IR <s>" nebo "RF <s>"
+    edge_socket_server_init(9993);
+
     ESP_LOGI(TAG, "VERZE 5");
 }
@@ -0,0 +1,325 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "sockhelper.h"
+#include "metrics.h"
+#include "socrf.h"
+
+#define TAG "METRICS"
+
+typedef struct {
+    uint32_t buckets[METRIC_HISTOGRAM_BUCKETS];     // pocet hodnot <= 16 << (2 * i) us
+    uint32_t count;
+    uint64_t sum;
+} histogram_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+} metric_desc_t;
+
+static const metric_desc_t counter_desc[METRIC_COUNTER_COUNT] = {
+    [METRIC_IRTX_SESSIONS] = {"irtx_sessions_total", "Spojeni na IR bootloader vysilac"},
+    [METRIC_IRTX_BYTES] = {"irtx_bytes_total", "Bajty odvysilane pro bootloader"},
+    [METRIC_IRTX_BUSY_US] = {"irtx_busy_us_total", "Doba vysilani pro bootloader"},
+    [METRIC_IRTX_ERRORS] = {"irtx_errors_total", "Odmitnuta nebo chybna data pro bootloader"},
+    [METRIC_IRNEC_SESSIONS] = {"irnec_sessions_total", "Spojeni na IR NEC vysilac"},
+    [METRIC_IRNEC_BYTES] = {"irnec_bytes_total", "Bajty odvysilane protokolem NEC"},
+    [METRIC_IRNEC_BUSY_US] = {"irnec_busy_us_total", "Doba vysilani protokolem NEC"},
+    [METRIC_OTA_SESSIONS] = {"ota_sessions_total", "Pokusy o OTA"},
+    [METRIC_OTA_BYTES] = {"ota_bytes_total", "Bajty zapsane do OTA oddilu"},
+    [METRIC_OTA_BUSY_US] = {"ota_busy_us_total", "Doba zapisu OTA"},
+    [METRIC_OTA_ERRORS] = {"ota_errors_total", "Chyby OTA"},
+    [METRIC_TSDB_SAMPLES] = {"tsdb_samples_total", "Vzorky ulozene do tsdb"},
+    [METRIC_TSDB_CHUNKS] = {"tsdb_chunks_total", "Bloky zapsane do flash"},
+    [METRIC_TSDB_ERRORS] = {"tsdb_errors_total", "Chyby zapisu do flash"},
+    [METRIC_WIFI_DISCONNECTS] = {"wifi_disconnects_total", "Odpojeni od AP nebo neuspesna pripojeni"},
+    [METRIC_RF_FRAMES] = {"rf_frames_total", "Prijate ramce ze senzoru"},
+    [METRIC_RF_ERRORS] = {"rf_errors_total", "Odmitnute ramce ze senzoru"},
+    [METRIC_RF_DUPLICATES] = {"rf_duplicates_total", "Opakovane kopie zprav"},
+    [METRIC_RF_ALERTS] = {"rf_alerts_total", "Poplachy pri pohybu"},
+    [METRIC_RF_ALERTS_STALE] = {"rf_alerts_stale_total", "Odmitnute poplachy se starym msg_id"},
+    [METRIC_RF_FUSION_EVICTED] = {"rf_fusion_evicted_total", "Zpravy vytlacene z okna slucovani prijimacu"},
+    [METRIC_EDGE_DROPPED] = {"edge_dropped_total", "Ztracene bloky zaznamu hran"},
+};
+
+static const metric_desc_t gauge_desc[METRIC_GAUGE_COUNT] = {
+    [METRIC_BOOT_TO_IP_MS] = {"boot_to_ip_ms", "Od startu po ziskani IP"},
+    [METRIC_BOOT_TO_LISTEN_MS] = {"boot_to_listen_ms", "Od startu po naslouchajici soket irtx"},
+    [METRIC_TSDB_MAX_ERASES] = {"tsdb_max_erases", "Nejvic smazani jednoho sektoru tsdb"},
+};
+
+static const metric_desc_t histogram_desc[METRIC_HISTOGRAM_COUNT] = {
+    [METRIC_IRTX_RMT_US] = {"irtx_rmt_us", "Doba vysilani RMT pro bootloader"},
+    [METRIC_IRTX_ACCEPT_US] = {"irtx_accept_to_tx_us", "Od prijeti spojeni po prvni symbol"},
+    [METRIC_IRNEC_RMT_US] = {"irnec_rmt_us", "Doba vysilani RMT protokolem NEC"},
+    [METRIC_OTA_WRITE_US] = {"ota_write_us", "Doba jednoho esp_ota_write"},
+    [METRIC_RF_ALERT_LEAD_US] = {"rf_alert_lead_us", "Predstih poplachu pred plnym hlasenim"},
+};
+
+// vypocet b/s z dvojice citacu bajty / doba
+static const struct {
+    const char *name;
+    metric_counter_t bytes, busy;
+} rate_desc[] = {
+    {"irtx_bytes_per_second", METRIC_IRTX_BYTES, METRIC_IRTX_BUSY_US},
+    {"irnec_bytes_per_second", METRIC_IRNEC_BYTES, METRIC_IRNEC_BUSY_US},
+    {"ota_bytes_per_second", METRIC_OTA_BYTES, METRIC_OTA_BUSY_US},
+};
+
+bool trace_enabled = false;
+
+static portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+// 64bit - *_busy_us_total by v uint32 preteklo za 71 minut vysilani
+static uint64_t _counters[METRIC_COUNTER_COUNT];
+static uint32_t _gauges[METRIC_GAUGE_COUNT];
+static histogram_t _histograms[METRIC_HISTOGRAM_COUNT];
+static uint32_t _sensor_frames[256];
+static uint32_t _sensor_crc_errors[256];
+
+typedef struct {
+    bool used;
+    uint8_t sensor_id;
+    int64_t updated_us;
+    uint16_t stack_free;            // nejmensi hlasena hodnota
+    uint32_t active_ms[3];          // AM2302, RF, IR
+    uint32_t wakeups[4];            // WDT, PIR, RCWL, IR sum
+    uint32_t am2302_errors[3];
+    uint8_t rx_dropped;             // posledni hodnota - na senzoru 8bit citac
+} sensor_telemetry_t;
+
+static sensor_telemetry_t _telemetry[METRIC_TELEMETRY_SENSORS];
+
+void metric_add(metric_counter_t counter, uint32_t value) {
+    portENTER_CRITICAL(&_lock);
+    _counters[counter] += value;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void metric_gauge(metric_gauge_t gauge, uint32_t value) {
+    _gauges[gauge] = value;
+}
+
+void metric_observe(metric_histogram_t histogram, uint32_t value_us) {
+    int bucket = 0;
+    while (bucket < METRIC_HISTOGRAM_BUCKETS && value_us > (16UL << (2 * bucket))) bucket++;
+
+    histogram_t *h = &_histograms[histogram];
+    portENTER_CRITICAL(&_lock);
+    if (bucket < METRIC_HISTOGRAM_BUCKETS) h->buckets[bucket]++;
+    h->count++;
+    h->sum += value_us;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void metric_sensor_frame(uint8_t sensor_id, bool crc_ok) {
+    portENTER_CRITICAL(&_lock);
+    if (crc_ok) _sensor_frames[sensor_id]++;
+    else _sensor_crc_errors[sensor_id]++;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void metric_sensor_telemetry(const sensormsg_telemetry_t *t) {
+    sensor_telemetry_t *slot = NULL, *oldest = &_telemetry[0];
+
+    portENTER_CRITICAL(&_lock);
+    for (int i = 0; i < METRIC_TELEMETRY_SENSORS && !slot; i++) {
+        sensor_telemetry_t *s = &_telemetry[i];
+        if (s->used && s->sensor_id == t->sensor_id) slot = s;
+        else if (!s->used || (oldest->used && s->updated_us < oldest->updated_us)) oldest = s;
+    }
+    if (!slot) {
+        slot = oldest;
+        memset(slot, 0, sizeof(*slot));
+        slot->used = true;
+        slot->sensor_id = t->sensor_id;
+        slot->stack_free = UINT16_MAX;
+    }
+
+    slot->updated_us = esp_timer_get_time();
+    if (t->stack_free < slot->stack_free) slot->stack_free = t->stack_free;
+    slot->active_ms[0] += t->am2302_ms;
+    slot->active_ms[1] += t->rf_ms;
+    slot->active_ms[2] += t->ir_ms;
+    slot->wakeups[0] += t->wake_wdt;
+    slot->wakeups[1] += t->wake_pir;
+    slot->wakeups[2] += t->wake_rcwl;
+    slot->wakeups[3] += t->wake_ir_noise;
+    for (int i = 0; i < 3; i++) slot->am2302_errors[i] += t->am2302_err[i];
+    slot->rx_dropped = t->rx_dropped;
+    portEXIT_CRITICAL(&_lock);
+}
+
+typedef struct {
+    int sock;
+    size_t len;
+    char buf[1024];
+} scrape_out_t;
+
+static void out_flush(scrape_out_t *out) {
+    size_t sent = 0;
+    while (sent < out->len) {
+        int n = send(out->sock, out->buf + sent, out->len - sent, 0);
+        if (n <= 0) break;
+        sent += n;
+    }
+    out->len = 0;
+}
+
+static void out_printf(scrape_out_t *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void out_printf(scrape_out_t *out, const char *fmt, ...) {
+    va_list ap;
+    if (sizeof(out->buf) - out->len < 160) out_flush(out);
+    va_start(ap, fmt);
+    int n = vsnprintf(out->buf + out->len, sizeof(out->buf) - out->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) out->len += n < sizeof(out->buf) - out->len ? n : sizeof(out->buf) - out->len - 1;
+}
+
+static void write_metrics(scrape_out_t *out) {
+    // kopie pod zamkem, vypisuje se uz bez nej
+    static uint64_t counters[METRIC_COUNTER_COUNT];
+    static uint32_t gauges[METRIC_GAUGE_COUNT];
+    static histogram_t histograms[METRIC_HISTOGRAM_COUNT];
+    static uint32_t frames[256], crc_errors[256];
+    static sensor_telemetry_t telemetry[METRIC_TELEMETRY_SENSORS];
+    static rffusion_receiver_t receivers[RFFUSION_RECEIVERS];
+
+    portENTER_CRITICAL(&_lock);
+    memcpy(counters, _counters, sizeof(counters));
+    memcpy(gauges, _gauges, sizeof(gauges));
+    memcpy(histograms, _histograms, sizeof(histograms));
+    memcpy(frames, _sensor_frames, sizeof(frames));
+    memcpy(crc_errors, _sensor_crc_errors, sizeof(crc_errors));
+    memcpy(telemetry, _telemetry, sizeof(telemetry));
+    portEXIT_CRITICAL(&_lock);
+    size_t receiver_count = rf_receivers(receivers, RFFUSION_RECEIVERS);
+
+    out_printf(out, "# TYPE uptime_us gauge\nuptime_us %" PRId64 "\n", esp_timer_get_time());
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        out_printf(out, "# HELP %s %s\n# TYPE %s counter\n%s %" PRIu64 "\n",
+                   counter_desc[i].name, counter_desc[i].help, counter_desc[i].name, counter_desc[i].name, counters[i]);
+    }
+
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        out_printf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %" PRIu32 "\n",
+                   gauge_desc[i].name, gauge_desc[i].help, gauge_desc[i].name, gauge_desc[i].name, gauges[i]);
+    }
+
+    for (int i = 0; i < sizeof(rate_desc) / sizeof(rate_desc[0]); i++) {
+        uint64_t busy = counters[rate_desc[i].busy];
+        out_printf(out, "# TYPE %s gauge\n%s %.1f\n", rate_desc[i].name, rate_desc[i].name,
+                   busy ? counters[rate_desc[i].bytes] * 1e6 / busy : 0.0);
+    }
+
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const char *name = histogram_desc[i].name;
+        histogram_t *h = &histograms[i];
+        uint32_t cumulative = 0;
+
+        out_printf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, histogram_desc[i].help, name);
+        for (int b = 0; b < METRIC_HISTOGRAM_BUCKETS; b++) {
+            cumulative += h->buckets[b];
+            out_printf(out, "%s_bucket{le=\"%lu\"} %" PRIu32 "\n", name, 16UL << (2 * b), cumulative);
+        }
+        out_printf(out, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n%s_sum %" PRIu64 "\n%s_count %" PRIu32 "\n",
+                   name, h->count, name, h->sum, name, h->count);
+    }
+
+    out_printf(out, "# TYPE sensor_frames_total counter\n# TYPE sensor_crc_errors_total counter\n");
+    for (int id = 0; id < 256; id++) {
+        if (!frames[id] && !crc_errors[id]) continue;
+        out_printf(out, "sensor_frames_total{sensor=\"%d\"} %" PRIu32 "\n"
+                        "sensor_crc_errors_total{sensor=\"%d\"} %" PRIu32 "\n",
+                   id, frames[id], id, crc_errors[id]);
+    }
+
+    out_printf(out, "# TYPE rf_receiver_frames_total counter\n# TYPE rf_receiver_first_total counter\n"
+                    "# TYPE rf_receiver_duplicates_total counter\n# TYPE rf_receiver_errors_total counter\n"
+                    "# TYPE rf_receiver_connected gauge\n");
+    for (size_t i = 0; i < receiver_count; i++) {
+        rffusion_receiver_t *r = &receivers[i];
+        out_printf(out, "rf_receiver_frames_total{receiver=\"%s\"} %" PRIu32 "\n"
+                        "rf_receiver_first_total{receiver=\"%s\"} %" PRIu32 "\n"
+                        "rf_receiver_duplicates_total{receiver=\"%s\"} %" PRIu32 "\n"
+                        "rf_receiver_errors_total{receiver=\"%s\"} %" PRIu32 "\n"
+                        "rf_receiver_connected{receiver=\"%s\"} %u\n",
+                   r->name, r->frames, r->name, r->first, r->name, r->duplicates, r->name, r->errors,
+                   r->name, r->connected);
+    }
+
+    static const char *const active_part[] = {"am2302", "rf", "ir"};
+    static const char *const wake_cause[] = {"wdt", "pir", "rcwl", "ir_noise"};
+    static const char *const am2302_code[] = {"fd", "fe", "ff"};
+
+    out_printf(out, "# TYPE sensor_stack_free_bytes gauge\n# TYPE sensor_active_ms_total counter\n"
+                    "# TYPE sensor_wakeups_total counter\n# TYPE sensor_am2302_errors_total counter\n"
+                    "# TYPE sensor_rx_dropped gauge\n");
+    for (int i = 0; i < METRIC_TELEMETRY_SENSORS; i++) {
+        sensor_telemetry_t *t = &telemetry[i];
+        if (!t->used) continue;
+        out_printf(out, "sensor_stack_free_bytes{sensor=\"%d\"} %u\nsensor_rx_dropped{sensor=\"%d\"} %u\n",
+                   t->sensor_id, t->stack_free, t->sensor_id, t->rx_dropped);
+        for (int p = 0; p < 3; p++) {
+            out_printf(out, "sensor_active_ms_total{sensor=\"%d\",part=\"%s\"} %" PRIu32 "\n",
+                       t->sensor_id, active_part[p], t->active_ms[p]);
+        }
+        for (int c = 0; c < 4; c++) {
+            out_printf(out, "sensor_wakeups_total{sensor=\"%d\",cause=\"%s\"} %" PRIu32 "\n",
+                       t->sensor_id, wake_cause[c], t->wakeups[c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            out_printf(out, "sensor_am2302_errors_total{sensor=\"%d\",code=\"%s\"} %" PRIu32 "\n",
+                       t->sensor_id, am2302_code[c], t->am2302_errors[c]);
+        }
+    }
+}
+
+static int do_scrape(int sock) {
+    char line[64];
+
+    // prikaz je nepovinny - bez nej se po chvili jen vypisou hodnoty
+    struct timeval tv = {.tv_sec = 0, .tv_usec = 200000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    socket_read_line(sock, line, sizeof(line));
+
+    static scrape_out_t out;
+    out.sock = sock;
+    out.len = 0;
+
+    if (!strncmp(line, "trace ", 6)) {
+        trace_enabled = atoi(line + 6) != 0;
+        ESP_LOGI(TAG, "Trace %s", trace_enabled ? "zapnut" : "vypnut");
+        out_printf(&out, "trace %d\n", trace_enabled);
+    } else {
+        if (!strncmp(line, "GET ", 4)) {
+            out_printf(&out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n");
+        }
+        write_metrics(&out);
+    }
+
+    out_flush(&out);
+    return 0;
+}
+
+void metrics_socket_server_init(int socket_port) {
+    socket_server_params *params = malloc(sizeof(socket_server_params));
+    params->port = socket_port;
+    params->handler = do_scrape;
+    params->redirect_stdout = false;
+    params->redirect_stdin = false;
+    params->upload_ready = false;
+
+    xTaskCreate(socket_server, "metrics_socket_server", 4096, params, 3, NULL);
+}
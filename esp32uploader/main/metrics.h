@@ -0,0 +1,72 @@
+#pragma once
+
+// Citace a histogramy pro sledovani brany. Zapis je jen par instrukci v kriticke sekci,
+// takze se da volat i z cest, kde zalezi na case (vysilani IR, OTA).
+// Vystup je textovy (format Prometheus) na portu metrics_socket_server_init - staci
+// "echo | ncat esp 9996" nebo HTTP GET. Radek "trace 1" / "trace 0" zapne / vypne hex vypisy.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "sensormsg.h"
+
+typedef enum {
+    METRIC_IRTX_SESSIONS,
+    METRIC_IRTX_BYTES,          // bajty odvysilane vcetne preambule
+    METRIC_IRTX_BUSY_US,        // doba vysilani - bytes / busy = b/s
+    METRIC_IRTX_ERRORS,
+    METRIC_IRNEC_SESSIONS,
+    METRIC_IRNEC_BYTES,
+    METRIC_IRNEC_BUSY_US,
+    METRIC_OTA_SESSIONS,
+    METRIC_OTA_BYTES,
+    METRIC_OTA_BUSY_US,
+    METRIC_OTA_ERRORS,
+    METRIC_TSDB_SAMPLES,
+    METRIC_TSDB_CHUNKS,
+    METRIC_TSDB_ERRORS,
+    METRIC_WIFI_DISCONNECTS,
+    METRIC_RF_FRAMES,           // ramce ze senzoru s platnou delkou a CRC
+    METRIC_RF_ERRORS,           // chybna delka, CRC nebo neznamy typ zpravy
+    METRIC_RF_DUPLICATES,       // kazda zprava jde dvakrat - druha kopie se zahodi
+    METRIC_RF_ALERTS,           // poplachy pri pohybu pred plnym hlasenim
+    METRIC_RF_ALERTS_STALE,     // poplach s msg_id, ktere uz prislo v hlaseni - opakovany zaznam
+    METRIC_RF_FUSION_EVICTED,   // zpravy vytlacene z okna rffusion driv nez za RFFUSION_WINDOW_MS
+    METRIC_EDGE_DROPPED,        // bloky symbolu RMT, ktere se nevesly do bufferu zaznamu hran
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum {
+    METRIC_IRTX_RMT_US,         // rmt_transmit az rmt_tx_wait_all_done
+    METRIC_IRTX_ACCEPT_US,      // accept spojeni az prvni symbol
+    METRIC_IRNEC_RMT_US,
+    METRIC_OTA_WRITE_US,        // jedno esp_ota_write
+    METRIC_RF_ALERT_LEAD_US,    // o kolik poplach predbehl hlaseni se stejnym msg_id
+    METRIC_HISTOGRAM_COUNT
+} metric_histogram_t;
+
+typedef enum {
+    METRIC_BOOT_TO_IP_MS,       // od startu po posledni ziskani IP
+    METRIC_BOOT_TO_LISTEN_MS,   // od startu po otevreni soketu irtx - brana prijima nahravani
+    METRIC_TSDB_MAX_ERASES,     // nejvic smazani jednoho sektoru tsdb - opotrebeni flash
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+// hranice prihradek histogramu jsou mocniny 4: 16 us .. 16 s
+#define METRIC_HISTOGRAM_BUCKETS 11
+// kolik senzoru s telemetrii drzime, dalsi nahradi nejdele neaktualizovany
+#define METRIC_TELEMETRY_SENSORS 16
+
+extern bool trace_enabled;
+
+#define TRACE_HEX(tag, buf, len) do { if (trace_enabled) ESP_LOG_BUFFER_HEX(tag, buf, len); } while (0)
+
+void metric_add(metric_counter_t counter, uint32_t value);
+void metric_gauge(metric_gauge_t gauge, uint32_t value);
+void metric_observe(metric_histogram_t histogram, uint32_t value_us);
+// prijaty ramec ze senzoru - crc_ok = false pocita chybu CRC
+void metric_sensor_frame(uint8_t sensor_id, bool crc_ok);
+// telemetrie senzoru - citace za interval se scitaji, stack_free je minimum
+void metric_sensor_telemetry(const sensormsg_telemetry_t *telemetry);
+
+void metrics_socket_server_init(int socket_port);
@@ -0,0 +1,164 @@
+#include <string.h>
+#include "irframe.h"
+#include "pllrx.h"
+
+// bootloader/bootloader.S a RadioHead RH_ASK
+#define RAMP_LEN            160
+#define RAMP_TRANSITION     80
+#define RAMP_INC            20
+#define RAMP_ADJUST         9           // RH_ASK_RAMP_ADJUST - posun faze na hrane
+#define BOOTLOADER_START    0x4655      // "FU"
+#define BOOTLOADER_START_NRZ 0x464E     // "FN"
+#define RHASK_START         0xB38       // symboly 0x38, 0x2c - nejstarsi bit vpravo
+#define RHASK_START_NRZ     0x8F8       // symboly 0x38, 0x23
+
+static const uint8_t symbols[16] = {
+    0x0d, 0x0e, 0x13, 0x15, 0x16, 0x19, 0x1a, 0x1c,
+    0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34,
+};
+
+// jako code_to_nibble v bootloader.S - neznamy kod vraci 0x10
+static uint8_t symbol_6to4(pllrx_t *rx, uint8_t symbol) {
+    for (uint8_t i = 0; i < 16; i++) {
+        if (symbols[i] == symbol) return i;
+    }
+    rx->bad_symbols++;
+    return 0x10;
+}
+
+void pllrx_init(pllrx_t *rx, pllrx_mode_t mode, uint32_t bit_rate, pllrx_frame_cb cb, void *ctx) {
+    memset(rx, 0, sizeof(*rx));
+    rx->mode = mode;
+    rx->sample_ns = 1000000000UL / bit_rate / 8;
+    rx->cb = cb;
+    rx->ctx = ctx;
+}
+
+void pllrx_reset(pllrx_t *rx) {
+    rx->active = false;
+    rx->bits = 0;
+    rx->integrator = 0;
+}
+
+static void start_frame(pllrx_t *rx, bool nrz, size_t expected) {
+    rx->active = true;
+    rx->nrz = nrz;
+    rx->scrambler = IRFRAME_SCRAMBLER_SEED;
+    rx->bit_count = 0;
+    rx->len = 0;
+    rx->crc = 0;
+    rx->expected = expected;
+}
+
+static void frame_done(pllrx_t *rx) {
+    bool ok = rx->crc == 0;
+    rx->active = false;
+    rx->frames++;
+    if (rx->nrz) rx->nrz_frames++;
+    if (!ok) rx->crc_errors++;
+    // pllrx_feed vola pllrx_sample s casem prave zpracovaneho vzorku v next_sample_ns
+    if (rx->cb) rx->cb(rx->ctx, rx->buf, rx->len, ok, rx->next_sample_ns);
+}
+
+static void got_byte(pllrx_t *rx, uint8_t byte) {
+    rx->crc = irframe_crc8(rx->crc, byte);
+    rx->buf[rx->len++] = byte;
+
+    if (rx->mode == PLLRX_RHASK && rx->len == 1) {
+        // prvni byte je delka vcetne sebe a CRC
+        if (byte < 3 || byte > PLLRX_MAX_FRAME) {
+            rx->active = false;
+            return;
+        }
+        rx->expected = byte;
+    }
+
+    if (rx->len >= rx->expected) frame_done(rx);
+}
+
+static void got_bit(pllrx_t *rx, uint8_t bit) {
+    if (rx->mode == PLLRX_BOOTLOADER) {
+        // bootloader.S: rxBits <<= 1, 16 bitu pro START symbol
+        rx->bits = rx->bits << 1 | bit;
+        if (!rx->active) {
+            if (rx->bits == BOOTLOADER_START || rx->bits == BOOTLOADER_START_NRZ) {
+                start_frame(rx, rx->bits == BOOTLOADER_START_NRZ, IRFRAME_FRAME_LEN);
+            }
+            return;
+        }
+        if (++rx->bit_count < (rx->nrz ? 8 : 12)) return;
+        rx->bit_count = 0;
+
+        if (rx->nrz) {
+            got_byte(rx, rx->bits ^ irframe_scrambler_next(&rx->scrambler, 0));
+            return;
+        }
+
+        // prvni symbol je v hornich 6 bitech
+        uint8_t lo = symbol_6to4(rx, rx->bits & 0x3F);
+        uint8_t hi = symbol_6to4(rx, (rx->bits >> 6) & 0x3F);
+        got_byte(rx, (uint8_t)(hi << 4 | hi >> 4) | lo);
+        return;
+    }
+
+    // RH_ASK: rxBits >>= 1, 12 bitu
+    rx->bits = (rx->bits >> 1) | (uint16_t)bit << 11;
+    if (!rx->active) {
+        if (rx->bits == RHASK_START || rx->bits == RHASK_START_NRZ) {
+            start_frame(rx, rx->bits == RHASK_START_NRZ, PLLRX_MAX_FRAME);
+        }
+        return;
+    }
+    if (++rx->bit_count < (rx->nrz ? 8 : 12)) return;
+    rx->bit_count = 0;
+
+    if (rx->nrz) {
+        // 8 bitu LSB first - nejstarsi je v bitu 4
+        got_byte(rx, (rx->bits >> 4) ^ irframe_scrambler_next(&rx->scrambler, 1));
+        return;
+    }
+
+    // RadioHead vraci pro neznamy kod 0
+    uint8_t hi = symbol_6to4(rx, rx->bits & 0x3F) & 0x0F;
+    uint8_t lo = symbol_6to4(rx, rx->bits >> 6) & 0x0F;
+    got_byte(rx, hi << 4 | lo);
+}
+
+void pllrx_sample(pllrx_t *rx, uint8_t level) {
+    level = level ? 1 : 0;
+    if (level) rx->integrator++;
+
+    if (rx->mode == PLLRX_BOOTLOADER) {
+        // bootloader.S: na hrane -11 / +9 a vzdy +20, 8bit registr
+        if (level != rx->last_sample) rx->ramp += rx->ramp < RAMP_TRANSITION ? -11 : 9;
+        rx->ramp += RAMP_INC;
+    } else if (level != rx->last_sample) {
+        rx->ramp += rx->ramp < RAMP_TRANSITION ? RAMP_INC - RAMP_ADJUST : RAMP_INC + RAMP_ADJUST;
+    } else {
+        rx->ramp += RAMP_INC;
+    }
+    rx->last_sample = level;
+
+    if (rx->ramp < RAMP_LEN) return;
+    rx->ramp -= RAMP_LEN;
+    uint8_t bit = rx->integrator >= 5;
+    rx->integrator = 0;
+    got_bit(rx, bit);
+}
+
+void pllrx_feed(pllrx_t *rx, uint8_t level, uint64_t duration_ns) {
+    // dlouhy usek - prvnich PLLRX_IDLE_SAMPLES vzorku dokonci rozpracovany ramec v jeho skutecnem case,
+    // zbytek se preskoci (faze vzorkovani zustane)
+    uint64_t idle_end = rx->t_ns + (uint64_t)PLLRX_IDLE_SAMPLES * rx->sample_ns;
+    rx->t_ns += duration_ns;
+
+    while (rx->next_sample_ns < rx->t_ns) {
+        if (rx->next_sample_ns >= idle_end) {
+            rx->next_sample_ns += (rx->t_ns - rx->next_sample_ns) / rx->sample_ns * rx->sample_ns;
+            idle_end = rx->t_ns;
+            continue;
+        }
+        pllrx_sample(rx, level);
+        rx->next_sample_ns += rx->sample_ns;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// Softwarovy prijimac RH_ASK (PLL, 8 vzorku na bit) - bez zavislosti na ESP-IDF. Dva rezimy:
+//   PLLRX_BOOTLOADER - port prijmu z bootloader/bootloader.S: bity MSB first, START symbol "FU" (4b6b)
+//                      nebo "FN" (NRZ, irframe.h), ramec ZH, ZL, index, 64 B, CRC8 (IRFRAME_FRAME_LEN)
+//   PLLRX_RHASK      - dekoder ramcu RadioHead, jak je vysila example/motionrx/sender.S: preambule
+//                      konci symboly 0x38 0x2c (4b6b) nebo 0x38 0x23 (NRZ, bity LSB first),
+//                      ramec [delka] data [CRC8] (vstup pro sensormsg_unframe)
+// Vstupem jsou useky signalu (uroven a delka) - napr. ze zaznamu edgetrace.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PLLRX_MAX_FRAME     80
+#define PLLRX_IDLE_SAMPLES  256     // delsi klid se preskoci - musi byt delsi nez beh stejnych bitu v NRZ
+
+typedef enum {
+    PLLRX_BOOTLOADER,
+    PLLRX_RHASK,
+} pllrx_mode_t;
+
+// frame vcetne hlavicky a CRC, t_ns - cas prijeti posledniho bitu
+typedef void (*pllrx_frame_cb)(void *ctx, const uint8_t *frame, size_t len, bool crc_ok, uint64_t t_ns);
+
+typedef struct {
+    pllrx_mode_t mode;
+    uint32_t sample_ns;
+    uint64_t t_ns;              // konec dosud dodanych useku
+    uint64_t next_sample_ns;
+
+    uint8_t integrator;
+    uint8_t ramp;
+    uint8_t last_sample;
+    uint16_t bits;
+    bool active;
+    bool nrz;                   // ramec v kodovani NRZ - 8 bitu na byte, skrambler
+    uint8_t scrambler;
+    uint8_t bit_count;
+    uint8_t crc;
+    size_t len;
+    size_t expected;
+    uint8_t buf[PLLRX_MAX_FRAME];
+
+    pllrx_frame_cb cb;
+    void *ctx;
+
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t bad_symbols;       // 6bitovy kod mimo tabulku 4b6b
+    uint32_t nrz_frames;
+} pllrx_t;
+
+void pllrx_init(pllrx_t *rx, pllrx_mode_t mode, uint32_t bit_rate, pllrx_frame_cb cb, void *ctx);
+// jeden vzorek linky - volat 8x za bit
+void pllrx_sample(pllrx_t *rx, uint8_t level);
+// usek signalu se stejnou urovni
+void pllrx_feed(pllrx_t *rx, uint8_t level, uint64_t duration_ns);
+// preruseni zaznamu - rozpracovany ramec se zahodi
+void pllrx_reset(pllrx_t *rx);
@@ -0,0 +1,117 @@
+#include <string.h>
+#include <ctype.h>
+#include "rffusion.h"
+
+static uint32_t bucket_of(uint32_t key) {
+    // Fibonacci hash - sensor_id je v hornim bytu, msg_id roste po jedne
+    return (key * 2654435761u) >> 16 & (RFFUSION_BUCKETS - 1);
+}
+
+void rffusion_init(rffusion_t *f, uint32_t window_ms) {
+    memset(f, 0, sizeof(*f));
+    f->window_ms = window_ms;
+}
+
+int rffusion_receiver(rffusion_t *f, const char *name) {
+    char clean[RFFUSION_NAME_LEN] = {0};
+    int free_slot = -1;
+
+    // jmeno jde do stitku metrik - jen bezpecne znaky
+    strncpy(clean, name, sizeof(clean) - 1);
+    for (char *c = clean; *c; c++) {
+        if (!isalnum((unsigned char)*c) && !strchr("._:-", *c)) *c = '_';
+    }
+
+    for (int i = 0; i < RFFUSION_RECEIVERS; i++) {
+        rffusion_receiver_t *r = &f->receivers[i];
+        if (r->used && !strcmp(r->name, clean)) {
+            r->connected = true;
+            return i;
+        }
+        if (r->used && r->connected) continue;
+        if (free_slot < 0 || (f->receivers[free_slot].used &&
+                              (!r->used || r->last_ms < f->receivers[free_slot].last_ms))) free_slot = i;
+    }
+    if (free_slot < 0) return -1;
+
+    // volne misto nebo nejstarsi odpojeny prijimac - jeho statistika se zahodi
+    rffusion_receiver_t *r = &f->receivers[free_slot];
+    memset(r, 0, sizeof(*r));
+    r->used = true;
+    r->connected = true;
+    memcpy(r->name, clean, sizeof(r->name));
+    return free_slot;
+}
+
+void rffusion_disconnect(rffusion_t *f, int receiver) {
+    if (receiver >= 0 && receiver < RFFUSION_RECEIVERS) f->receivers[receiver].connected = false;
+}
+
+int rffusion_rename(rffusion_t *f, int receiver, const char *name) {
+    if (receiver >= 0 && receiver < RFFUSION_RECEIVERS) {
+        rffusion_receiver_t *r = &f->receivers[receiver];
+        r->connected = false;
+        if (!r->frames && !r->errors) r->used = false;
+    }
+    return rffusion_receiver(f, name);
+}
+
+static void drop_oldest(rffusion_t *f) {
+    rffusion_entry_t *e = &f->entries[f->oldest];
+    uint16_t *link = &f->heads[bucket_of(e->key)];
+
+    // nove zaznamy jdou na zacatek retezu, nejstarsi je na jeho konci
+    while (*link && *link - 1 != f->oldest) link = &f->entries[*link - 1].next;
+    if (*link) *link = e->next;
+
+    f->oldest = (f->oldest + 1) & (RFFUSION_WINDOW - 1);
+    f->count--;
+}
+
+bool rffusion_accept(rffusion_t *f, int receiver, uint32_t key, uint32_t now_ms) {
+    rffusion_receiver_t *r = receiver >= 0 && receiver < RFFUSION_RECEIVERS ? &f->receivers[receiver] : NULL;
+
+    if (r) {
+        r->frames++;
+        r->last_ms = now_ms;
+    }
+
+    while (f->count && now_ms - f->entries[f->oldest].time_ms > f->window_ms) drop_oldest(f);
+
+    uint32_t bucket = bucket_of(key);
+    for (uint16_t i = f->heads[bucket]; i; i = f->entries[i - 1].next) {
+        rffusion_entry_t *e = &f->entries[i - 1];
+        if (e->key != key) continue;
+        f->duplicates++;
+        if (r) r->duplicates++;
+        return false;
+    }
+
+    if (f->count == RFFUSION_WINDOW) {
+        drop_oldest(f);
+        f->evicted++;
+    }
+
+    uint16_t ix = (f->oldest + f->count) & (RFFUSION_WINDOW - 1);
+    rffusion_entry_t *e = &f->entries[ix];
+    e->key = key;
+    e->time_ms = now_ms;
+    e->next = f->heads[bucket];
+    f->heads[bucket] = ix + 1;
+    f->count++;
+
+    f->unique++;
+    if (r) r->first++;
+    return true;
+}
+
+void rffusion_count(rffusion_t *f, int receiver, uint32_t now_ms) {
+    if (receiver < 0 || receiver >= RFFUSION_RECEIVERS) return;
+    f->receivers[receiver].frames++;
+    f->receivers[receiver].first++;
+    f->receivers[receiver].last_ms = now_ms;
+}
+
+void rffusion_error(rffusion_t *f, int receiver) {
+    if (receiver >= 0 && receiver < RFFUSION_RECEIVERS) f->receivers[receiver].errors++;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Slouceni ramcu z vice prijimacu 433 MHz - bez zavislosti na ESP-IDF, stejne jako irframe.c,
+// aby slo prelozit i na hostu (sim/rfhub, sim/rfload).
+//
+// Senzor posila kazdou zpravu dvakrat a v budove ji slysi nekolik prijimacu. Zprava je klicovana
+// sensor_id + msg_id + druh (rffusion_key), dal jde jen prvni kopie. Okno pamatuje poslednich
+// RFFUSION_WINDOW zprav, nejdele RFFUSION_WINDOW_MS - pamet je pevna bez ohledu na provoz.
+// Vyhledani je hash s retezenim, vyrazeni nejstarsi zpravy O(1) - zaznamy tvori kruhovou frontu.
+//
+// Statistika po prijimacich: kolik platnych ramcu dodal, kolik z nich jako prvni (jeho prinos
+// k pokryti), kolik kopii a chyb.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define RFFUSION_WINDOW      512        // mocnina 2
+#define RFFUSION_BUCKETS     (2 * RFFUSION_WINDOW)
+#define RFFUSION_WINDOW_MS   10000      // druha kopie jde 400 ms po prvni, restart meni msg_id
+#define RFFUSION_RECEIVERS   16
+#define RFFUSION_NAME_LEN    24
+
+#define RFFUSION_KIND_MESSAGE 0         // hlaseni a telemetrie
+#define RFFUSION_KIND_ALERT   1         // poplach - msg_id sdili s hlasenim
+
+typedef struct {
+    bool used;
+    bool connected;
+    char name[RFFUSION_NAME_LEN];
+    uint32_t frames;        // platne ramce
+    uint32_t first;         // z toho prvni kopie zpravy
+    uint32_t duplicates;
+    uint32_t errors;        // chybne radky, CRC, neznama zprava
+    uint32_t last_ms;
+} rffusion_receiver_t;
+
+typedef struct {
+    uint32_t key;
+    uint32_t time_ms;
+    uint16_t next;          // dalsi v retezu + 1, 0 konec
+} rffusion_entry_t;
+
+typedef struct {
+    uint32_t window_ms;
+    uint16_t heads[RFFUSION_BUCKETS];           // index zaznamu + 1, 0 prazdny
+    rffusion_entry_t entries[RFFUSION_WINDOW];  // kruhova fronta podle casu prijeti
+    uint16_t oldest;
+    uint16_t count;
+    uint32_t unique;
+    uint32_t duplicates;
+    uint32_t evicted;       // vyrazeno plnym oknem driv nez vyprselo - okno je na provoz male
+    rffusion_receiver_t receivers[RFFUSION_RECEIVERS];
+} rffusion_t;
+
+void rffusion_init(rffusion_t *f, uint32_t window_ms);
+
+// prijimac podle jmena (stejne jmeno po znovupripojeni = stejna statistika), -1 pokud neni misto
+int rffusion_receiver(rffusion_t *f, const char *name);
+void rffusion_disconnect(rffusion_t *f, int receiver);
+// prijimac se predstavil jmenem - zatim prazdna statistika pod docasnym jmenem (IP) se uvolni
+int rffusion_rename(rffusion_t *f, int receiver, const char *name);
+
+static inline uint32_t rffusion_key(uint8_t sensor_id, uint16_t msg_id, uint8_t kind) {
+    return (uint32_t)sensor_id << 24 | (uint32_t)msg_id << 8 | kind;
+}
+
+// platny ramec od prijimace, vraci true pro prvni kopii zpravy (poslat dal)
+bool rffusion_accept(rffusion_t *f, int receiver, uint32_t key, uint32_t now_ms);
+// ramec bez msg_id (beacon) - jen statistika
+void rffusion_count(rffusion_t *f, int receiver, uint32_t now_ms);
+void rffusion_error(rffusion_t *f, int receiver);
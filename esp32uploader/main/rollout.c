@@ -0,0 +1,223 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "irframe.h"
+#include "fwstore.h"
+#include "socirnec.h"
+#include "socirtx.h"
+#include "socrf.h"
+#include "rollout.h"
+
+#define TAG "ROLLOUT"
+
+static QueueHandle_t _queue;
+static SemaphoreHandle_t _lock;
+static rollout_status_t _targets[ROLLOUT_MAX_TARGETS];
+static int _target_count;
+
+static const char *state_names[] = {
+    [ROLLOUT_QUEUED] = "queued",
+    [ROLLOUT_BOOTING] = "booting",
+    [ROLLOUT_UPLOADING] = "uploading",
+    [ROLLOUT_SENT] = "sent",
+    [ROLLOUT_DONE] = "done",
+    [ROLLOUT_FAILED] = "failed",
+};
+
+const char *rollout_state_name(uint8_t state) {
+    return state <= ROLLOUT_FAILED ? state_names[state] : "?";
+}
+
+// volat pod _lock
+static rollout_status_t *find_target(uint8_t sensor_id, bool create) {
+    for (int i = 0; i < _target_count; i++) {
+        if (_targets[i].sensor_id == sensor_id) return &_targets[i];
+    }
+    if (!create) return NULL;
+
+    // misto po nejstarsim dokoncenem cili
+    if (_target_count == ROLLOUT_MAX_TARGETS) {
+        rollout_status_t *oldest = NULL;
+        for (int i = 0; i < _target_count; i++) {
+            rollout_status_t *t = &_targets[i];
+            if ((t->state == ROLLOUT_DONE || t->state == ROLLOUT_FAILED) && (!oldest || t->time < oldest->time)) oldest = t;
+        }
+        if (!oldest) return NULL;
+        *oldest = _targets[--_target_count];
+    }
+
+    rollout_status_t *t = &_targets[_target_count++];
+    memset(t, 0, sizeof(*t));
+    t->sensor_id = sensor_id;
+    return t;
+}
+
+static void set_state(uint8_t sensor_id, rollout_state_t state, esp_err_t err) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    rollout_status_t *t = find_target(sensor_id, false);
+    if (t) {
+        t->state = state;
+        t->time = time(NULL);
+        if (err != ESP_OK) t->last_err = err;
+    }
+    xSemaphoreGive(_lock);
+    ESP_LOGI(TAG, "Senzor %d: %s", sensor_id, rollout_state_name(state));
+}
+
+esp_err_t rollout_enter_bootloader(uint8_t sensor_id) {
+    char cmd[16];
+    int64_t start = esp_timer_get_time();
+
+    uint32_t beacons = rf_beacon_count();
+    snprintf(cmd, sizeof(cmd), "B %d", sensor_id);
+    esp_err_t err = irnec_send_command(cmd);
+    if (err != ESP_OK) return err;
+
+    if (!rf_wait_beacon(sensor_id, beacons, pdMS_TO_TICKS(ROLLOUT_BOOT_WAIT_MS))) return ESP_ERR_TIMEOUT;
+
+    ESP_LOGI(TAG, "Senzor %d: bootloader za %" PRId64 " ms", sensor_id, (esp_timer_get_time() - start) / 1000);
+    return ESP_OK;
+}
+
+static esp_err_t do_rollout(uint8_t sensor_id) {
+    static uint8_t image[IRFRAME_FLASH_LIMIT];
+    static uint8_t used[IRFRAME_PAGE_MAP_LEN];
+    fwstore_info_t info;
+
+    esp_err_t err = fwstore_get(sensor_id, &info, image, used);
+    if (err != ESP_OK) return err;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    rollout_status_t *t = find_target(sensor_id, false);
+    if (t) {
+        t->version = info.version;
+        t->attempts++;
+    }
+    xSemaphoreGive(_lock);
+
+    set_state(sensor_id, ROLLOUT_BOOTING, ESP_OK);
+    err = rollout_enter_bootloader(sensor_id);
+    // bez beaconu (chybi RF prijimac) zkusime vysilat po uplynuti cele doby
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) return err;
+
+    // NRZ jen kdyz ho bootloader prave ohlasil beaconem 'N'
+    set_state(sensor_id, ROLLOUT_UPLOADING, ESP_OK);
+    return irtx_send_image(image, info.len, used, err == ESP_OK ? rf_beacon_line_code(sensor_id) : IRFRAME_CODE_4B6B);
+}
+
+// Cile cekajici na opakovani vrati do fronty, az nastane jejich retry_at_us - worker mezitim
+// zpracovava ostatni. Vraci, jak dlouho cekat na frontu do dalsiho opakovani.
+static TickType_t requeue_retries(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t next = INT64_MAX;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int i = 0; i < _target_count; i++) {
+        rollout_status_t *t = &_targets[i];
+        if (!t->retry_at_us) continue;
+        if (t->retry_at_us <= now) {
+            t->retry_at_us = 0;
+            xQueueSend(_queue, &t->sensor_id, 0);
+        } else if (t->retry_at_us < next) {
+            next = t->retry_at_us;
+        }
+    }
+    xSemaphoreGive(_lock);
+
+    return next == INT64_MAX ? portMAX_DELAY : pdMS_TO_TICKS((next - now) / 1000) + 1;
+}
+
+static void rollout_task(void *pvParameter) {
+    uint8_t sensor_id;
+
+    while (1) {
+        if (xQueueReceive(_queue, &sensor_id, requeue_retries()) != pdTRUE) continue;
+
+        esp_err_t err = do_rollout(sensor_id);
+        if (err == ESP_OK) {
+            set_state(sensor_id, ROLLOUT_SENT, ESP_OK);
+            continue;
+        }
+
+        ESP_LOGE(TAG, "Senzor %d: %s", sensor_id, esp_err_to_name(err));
+
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        rollout_status_t *t = find_target(sensor_id, false);
+        bool retry = t && t->attempts < ROLLOUT_MAX_ATTEMPTS && err != ESP_ERR_NOT_FOUND;
+        if (retry) t->retry_at_us = esp_timer_get_time() + ROLLOUT_RETRY_WAIT_MS * 1000LL;
+        xSemaphoreGive(_lock);
+
+        set_state(sensor_id, retry ? ROLLOUT_QUEUED : ROLLOUT_FAILED, err);
+    }
+}
+
+esp_err_t rollout_init(void) {
+    _queue = xQueueCreate(ROLLOUT_MAX_TARGETS, sizeof(uint8_t));
+    _lock = xSemaphoreCreateMutex();
+    if (!_queue || !_lock) return ESP_ERR_NO_MEM;
+
+    xTaskCreate(rollout_task, "rollout", 4096, NULL, 4, NULL);
+    return ESP_OK;
+}
+
+esp_err_t rollout_enqueue(uint8_t sensor_id) {
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    rollout_status_t *t = find_target(sensor_id, true);
+    if (!t) {
+        err = ESP_ERR_NO_MEM;
+    } else if (t->time && (t->state == ROLLOUT_QUEUED || t->state == ROLLOUT_BOOTING || t->state == ROLLOUT_UPLOADING)) {
+        err = ESP_ERR_INVALID_STATE;    // uz ve fronte nebo probiha
+    } else {
+        t->state = ROLLOUT_QUEUED;
+        t->attempts = 0;
+        t->last_err = ESP_OK;
+        t->time = time(NULL);
+    }
+    xSemaphoreGive(_lock);
+
+    if (err == ESP_OK && xQueueSend(_queue, &sensor_id, 0) != pdTRUE) err = ESP_ERR_NO_MEM;
+    return err;
+}
+
+void rollout_report(uint8_t sensor_id, uint8_t version) {
+    bool retry = false;
+
+    if (!_lock) return;     // rollout_init neprobehl
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    rollout_status_t *t = find_target(sensor_id, false);
+    if (t && t->state == ROLLOUT_SENT) {
+        if (version == t->version) {
+            t->state = ROLLOUT_DONE;
+        } else if (t->attempts < ROLLOUT_MAX_ATTEMPTS) {
+            // senzor bezi se starou verzi - nahrani se nepovedlo
+            t->state = ROLLOUT_QUEUED;
+            retry = true;
+        } else {
+            t->state = ROLLOUT_FAILED;
+        }
+        t->time = time(NULL);
+        ESP_LOGI(TAG, "Senzor %d hlasi verzi 0x%02X: %s", sensor_id, version, rollout_state_name(t->state));
+    }
+    xSemaphoreGive(_lock);
+
+    if (retry) xQueueSend(_queue, &sensor_id, 0);
+}
+
+int rollout_list(void (*cb)(const rollout_status_t *status, void *ctx), void *ctx) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int i = 0; i < _target_count; i++) cb(&_targets[i], ctx);
+    int count = _target_count;
+    xSemaphoreGive(_lock);
+    return count;
+}
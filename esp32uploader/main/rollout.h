@@ -0,0 +1,42 @@
+#pragma once
+
+// Fronta aktualizaci senzoru: pro kazdy cil posle adresny prikaz "B <id>" (socirnec), pocka na beacon
+// bootloaderu (socrf), a odvysila obraz z fwstore (socirtx). Lokalni chyby se opakuji.
+// Potvrzeni dava az zprava ze senzoru s novou verzi (rollout_report) - bez prijmu RF zustane stav SENT.
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ROLLOUT_MAX_TARGETS   32
+#define ROLLOUT_MAX_ATTEMPTS  3
+#define ROLLOUT_BOOT_WAIT_MS  6000  // nejdele na beacon - bez RF prijimace se ceka cela doba
+#define ROLLOUT_RETRY_WAIT_MS 10000 // odstup opakovani po chybe - ostatni cile ve fronte mezitim bezi
+
+typedef enum {
+    ROLLOUT_QUEUED,
+    ROLLOUT_BOOTING,
+    ROLLOUT_UPLOADING,
+    ROLLOUT_SENT,           // odvysilano, ceka na zpravu s novou verzi
+    ROLLOUT_DONE,
+    ROLLOUT_FAILED,
+} rollout_state_t;
+
+typedef struct {
+    uint8_t sensor_id;
+    uint8_t state;          // rollout_state_t
+    uint8_t attempts;
+    uint8_t version;        // cilova verze z fwstore
+    uint32_t time;          // posledni zmena stavu
+    int64_t retry_at_us;    // opakovani po chybe az od tohoto casu (esp_timer), 0 - neceka
+    esp_err_t last_err;
+} rollout_status_t;
+
+esp_err_t rollout_init(void);
+esp_err_t rollout_enqueue(uint8_t sensor_id);
+// posle "B <id>" a pocka na beacon bootloaderu (nejdele ROLLOUT_BOOT_WAIT_MS), ESP_ERR_TIMEOUT bez nej
+esp_err_t rollout_enter_bootloader(uint8_t sensor_id);
+// zprava ze senzoru s verzi firmware - potvrdi nebo zopakuje aktualizaci
+void rollout_report(uint8_t sensor_id, uint8_t version);
+// projde stavy vsech cilu, vraci jejich pocet
+int rollout_list(void (*cb)(const rollout_status_t *status, void *ctx), void *ctx);
+const char *rollout_state_name(uint8_t state);
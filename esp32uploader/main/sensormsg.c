@@ -0,0 +1,187 @@
+#include <string.h>
+#include "irframe.h"
+#include "sensormsg.h"
+
+#define SPECK_ROUNDS 27
+
+// round_keys z encrypt.S jako 32bit slova
+static const uint32_t round_keys[SPECK_ROUNDS] = {
+    0x43505345, 0x941707be, 0x77db0a1b, 0xb2b1cf61, 0x37074996, 0x4929ff80, 0xad8374b5,
+    0xb36f2dc3, 0xf02a9451, 0xde5eaa5e, 0xd83caca7, 0x687ed39b, 0xfa5f0149, 0x72f096bc,
+    0x922ef5b7, 0x14b953e1, 0xcd746126, 0x41593902, 0x65083003, 0xb172aa3a, 0x49773df4,
+    0x20a99ea8, 0x47207440, 0x688826a5, 0x2d8ba61a, 0xb8800157, 0x2de9c14e,
+};
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t le16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+// 24bit citac zprav z otevrene hlavicky CTR (za sensor_id)
+static uint32_t ctr_header(const uint8_t *p) {
+    return le16(p + 1) | (uint32_t)p[3] << 16;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+void sensormsg_decrypt_block(uint8_t *block) {
+    // encrypt.S: y = byty 0-3, x = byty 4-7; kolo x = (x >>> 8) + y ^ k, y = (y <<< 3) ^ x
+    uint32_t y = le32(block);
+    uint32_t x = le32(block + 4);
+
+    for (int i = SPECK_ROUNDS - 1; i >= 0; i--) {
+        y ^= x;
+        y = y >> 3 | y << 29;
+        x ^= round_keys[i];
+        x -= y;
+        x = x << 8 | x >> 24;
+    }
+
+    put_le32(block, y);
+    put_le32(block + 4, x);
+}
+
+void sensormsg_encrypt_block(uint8_t *block) {
+    uint32_t y = le32(block);
+    uint32_t x = le32(block + 4);
+
+    for (int i = 0; i < SPECK_ROUNDS; i++) {
+        x = (x >> 8 | x << 24) + y;
+        x ^= round_keys[i];
+        y = (y << 3 | y >> 29) ^ x;
+    }
+
+    put_le32(block, y);
+    put_le32(block + 4, x);
+}
+
+void sensormsg_ctr_xor(uint8_t *data, size_t len, uint8_t sensor_id, uint32_t msg_ctr, uint8_t domain) {
+    for (size_t i = 0; i < len; i += SENSORMSG_BLOCK_LEN) {
+        uint8_t ks[SENSORMSG_BLOCK_LEN] = {sensor_id, msg_ctr, msg_ctr >> 8, i / SENSORMSG_BLOCK_LEN, domain,
+                                           msg_ctr >> 16};
+        sensormsg_encrypt_block(ks);
+        for (size_t j = 0; j < SENSORMSG_BLOCK_LEN && i + j < len; j++) data[i + j] ^= ks[j];
+    }
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int sensormsg_parse_hex(const char *text, uint8_t *frame, size_t maxlen) {
+    size_t len = 0;
+
+    while (*text) {
+        if (*text == ' ' || *text == '\t') {
+            text++;
+            continue;
+        }
+        int hi = hex_digit(text[0]);
+        int lo = hi < 0 ? -1 : hex_digit(text[1]);
+        if (lo < 0 || len >= maxlen) return -1;
+        frame[len++] = hi << 4 | lo;
+        text += 2;
+    }
+    return len;
+}
+
+size_t sensormsg_frame(const uint8_t *payload, size_t len, uint8_t *frame) {
+    uint8_t crc = 0;
+
+    frame[0] = len + 2;
+    memcpy(frame + 1, payload, len);
+    for (size_t i = 0; i <= len; i++) crc = irframe_crc8(crc, frame[i]);
+    frame[len + 1] = crc;
+    return len + 2;
+}
+
+const uint8_t *sensormsg_unframe(const uint8_t *frame, size_t len, size_t *payload_len) {
+    if (len < 3 || frame[0] != len) return NULL;
+
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) crc = irframe_crc8(crc, frame[i]);
+    if (crc) return NULL;   // CRC8 pres cely ramec vcetne CRC vyjde 0
+
+    *payload_len = len - 2;
+    return frame + 1;
+}
+
+sensormsg_type_t sensormsg_decode(uint8_t *payload, size_t len, sensormsg_t *msg) {
+    memset(msg, 0, sizeof(*msg));
+
+    if (len == SENSORMSG_BEACON_LEN &&
+        (payload[0] == SENSORMSG_BEACON_TYPE || payload[0] == SENSORMSG_BEACON_NRZ_TYPE)) {
+        msg->beacon.sensor_id = payload[1];
+        msg->beacon.nrz = payload[0] == SENSORMSG_BEACON_NRZ_TYPE;
+        return msg->type = SENSORMSG_BEACON;
+    }
+
+    if (len == SENSORMSG_CTR_ALERT_LEN) {
+        sensormsg_alert_t *a = &msg->alert;
+        uint8_t *data = payload + SENSORMSG_CTR_HEADER_LEN;
+        a->sensor_id = payload[0];
+        a->msg_id = le16(payload + 1);
+        sensormsg_ctr_xor(data, SENSORMSG_ALERT_LEN, a->sensor_id, ctr_header(payload), SENSORMSG_DOMAIN_ALERT);
+        if (memcmp(data, payload, SENSORMSG_CTR_HEADER_LEN)) return SENSORMSG_INVALID;
+        a->flags = data[SENSORMSG_CTR_HEADER_LEN];
+        if (!a->flags || a->flags & ~SENSORMSG_ALERT_FLAGS) return SENSORMSG_INVALID;
+        return msg->type = SENSORMSG_ALERT;
+    }
+
+    if (len == SENSORMSG_CTR_REPORT_LEN || len == SENSORMSG_CTR_TELEMETRY_LEN) {
+        uint8_t sensor_id = payload[0];
+        uint16_t msg_id = le16(payload + 1);
+        uint32_t msg_ctr = ctr_header(payload);
+
+        len -= SENSORMSG_CTR_HEADER_LEN;
+        memmove(payload, payload + SENSORMSG_CTR_HEADER_LEN, len);
+        sensormsg_ctr_xor(payload, len, sensor_id, msg_ctr, SENSORMSG_DOMAIN_MESSAGE);
+        if (payload[0] != sensor_id || le16(payload + 1) != msg_id) return SENSORMSG_INVALID;
+    } else if (len == SENSORMSG_REPORT_LEN || len == SENSORMSG_TELEMETRY_LEN) {
+        for (size_t i = 0; i < len; i += SENSORMSG_BLOCK_LEN) sensormsg_decrypt_block(payload + i);
+    } else {
+        return SENSORMSG_INVALID;
+    }
+
+    if (len == SENSORMSG_REPORT_LEN) {
+        sensormsg_report_t *r = &msg->report;
+        r->sensor_id = payload[0];
+        r->msg_id = le16(payload + 1);
+        r->tick = le32(payload + 3);
+        r->vcc = le16(payload + 7);
+        r->flags = payload[9];
+        r->version = payload[10];
+        r->humitemp = le32(payload + 11);
+        r->rx_dropped = payload[15];
+        return msg->type = SENSORMSG_REPORT;
+    }
+
+    // telemetrie - typ v 4. bytu odlisi spatny klic nebo cizi vysilac
+    if (payload[3] != SENSORMSG_TELEMETRY_TYPE) return SENSORMSG_INVALID;
+
+    sensormsg_telemetry_t *t = &msg->telemetry;
+    t->sensor_id = payload[0];
+    t->msg_id = le16(payload + 1);
+    t->stack_free = le16(payload + 4);
+    t->am2302_ms = le16(payload + 6);
+    t->rf_ms = le16(payload + 8);
+    t->ir_ms = le16(payload + 10);
+    t->wake_wdt = le16(payload + 12);
+    t->wake_pir = le16(payload + 14);
+    t->wake_rcwl = le16(payload + 16);
+    t->wake_ir_noise = le16(payload + 18);
+    memcpy(t->am2302_err, payload + 20, sizeof(t->am2302_err));
+    t->rx_dropped = payload[23];
+    return msg->type = SENSORMSG_TELEMETRY;
+}
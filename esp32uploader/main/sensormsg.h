@@ -0,0 +1,127 @@
+#pragma once
+
+// Dekodovani zprav ze senzoru (example/motionrx) prijatych pres 433 MHz - bez zavislosti na ESP-IDF,
+// stejne jako irframe.c, aby slo prelozit i na hostu.
+//
+// Ramec RH_ASK po demodulaci: [delka = n + 2] [n B dat] [CRC8 pres delku a data - jako calc_crc].
+// Data jsou sifrovana SPECK64/128 (encrypt.S). Druh zpravy urcuje delka:
+//   20 B - bezne hlaseni (message_t v main.c), CTR: sensor_id a 24bit citac zprav (LE) otevrene + 16 B
+//   28 B - telemetrie (telemetry_t v telemetry.h), CTR jako hlaseni + 24 B, posila se po N-tem heartbeatu
+//    9 B - poplach pri pohybu, CTR v domene SENSORMSG_DOMAIN_ALERT: hlavicka + 5 B kopie hlavicky a flags.
+//          Jde hned po probuzeni, hlaseni se stejnym msg_id prijde az po nem
+//   16 B, 24 B - totez ze starsiho firmware, ECB po 8 B
+//    2 B - beacon bootloaderu 'R' nebo 'N' sensor_id - nesifrovany, bootloader je pripraven prijimat stranky;
+//          'N' - bootloader prijme i stranky v kodovani NRZ (irframe.h)
+//
+// CTR: blok keystreamu i je SPECK(sensor_id, citac bity 0-7, 8-15, i, domena, citac bity 16-23, 0, 0),
+// data se XORuji. Dolnich 16 bitu citace je msg_id ve zprave, horni byte je epocha restartu senzoru
+// (EEPROM) - keystream se zopakuje az po 2^24 zpravach.
+// Otevrena hlavicka se musi shodovat s desifrovanym zacatkem zpravy - jinak jde o spatny klic nebo sum.
+//
+// Zpravy NEJSOU autentizovane - CTR nema MAC. Kontrola hlavicky odhali sum a ciziho odesilatele bez klice,
+// ale ne cilene prevracene bity dat (vcc, flags, humitemp, telemetrie) v zachycene zprave. Prehrani
+// stareho poplachu odmita socrf podle msg_id, na obsah hlaseni se pro rizeni nespolehat.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SENSORMSG_BLOCK_LEN     8
+#define SENSORMSG_BEACON_LEN    2
+#define SENSORMSG_REPORT_LEN    16
+#define SENSORMSG_TELEMETRY_LEN 24
+#define SENSORMSG_CTR_HEADER_LEN 4
+#define SENSORMSG_CTR_REPORT_LEN    (SENSORMSG_CTR_HEADER_LEN + SENSORMSG_REPORT_LEN)
+#define SENSORMSG_CTR_TELEMETRY_LEN (SENSORMSG_CTR_HEADER_LEN + SENSORMSG_TELEMETRY_LEN)
+#define SENSORMSG_MAX_LEN       SENSORMSG_CTR_TELEMETRY_LEN
+
+#define SENSORMSG_ALERT_LEN     (SENSORMSG_CTR_HEADER_LEN + 1)
+#define SENSORMSG_CTR_ALERT_LEN     (SENSORMSG_CTR_HEADER_LEN + SENSORMSG_ALERT_LEN)
+
+#define SENSORMSG_DOMAIN_MESSAGE 0  // domena citace CTR - hlaseni i telemetrie (jine msg_id)
+#define SENSORMSG_DOMAIN_ALERT   1  // poplach - msg_id sdili s naslednym hlasenim
+
+// flags hlaseni (FLAG_* v main.c), poplach nese jen pohyb
+#define SENSORMSG_FLAG_PIR   (1 << 1)
+#define SENSORMSG_FLAG_RCWL  (1 << 2)
+#define SENSORMSG_ALERT_FLAGS (SENSORMSG_FLAG_PIR | SENSORMSG_FLAG_RCWL)
+
+#define SENSORMSG_TELEMETRY_TYPE 0x54
+#define SENSORMSG_BEACON_TYPE    'R'
+#define SENSORMSG_BEACON_NRZ_TYPE 'N'
+
+// humitemp s chybou AM2302 - nejnizsi byte je kod, zbytek nulovy
+#define SENSORMSG_AM2302_ERROR(humitemp) (((humitemp) >> 8) == 0 && ((humitemp) & 0xFF) >= 0xFD)
+
+typedef enum {
+    SENSORMSG_INVALID,
+    SENSORMSG_REPORT,
+    SENSORMSG_TELEMETRY,
+    SENSORMSG_BEACON,
+    SENSORMSG_ALERT,
+} sensormsg_type_t;
+
+typedef struct {
+    uint8_t sensor_id;
+    uint16_t msg_id;
+    uint32_t tick;
+    uint16_t vcc;
+    uint8_t flags;
+    uint8_t version;
+    uint32_t humitemp;      // pri FLAG_CMD odpoved na prikaz
+    uint8_t rx_dropped;
+} sensormsg_report_t;
+
+typedef struct {
+    uint8_t sensor_id;
+    uint16_t msg_id;
+    uint16_t stack_free;
+    uint16_t am2302_ms;     // aktivni cas od minule telemetrie
+    uint16_t rf_ms;
+    uint16_t ir_ms;
+    uint16_t wake_wdt;
+    uint16_t wake_pir;
+    uint16_t wake_rcwl;
+    uint16_t wake_ir_noise;
+    uint8_t am2302_err[3];  // 0xFD timeout, 0xFE checksum, 0xFF bez senzoru
+    uint8_t rx_dropped;
+} sensormsg_telemetry_t;
+
+typedef struct {
+    uint8_t sensor_id;
+    uint16_t msg_id;        // stejne jako hlaseni, ktere nasleduje
+    uint8_t flags;          // SENSORMSG_ALERT_FLAGS
+} sensormsg_alert_t;
+
+typedef struct {
+    uint8_t sensor_id;
+    bool nrz;               // beacon 'N'
+} sensormsg_beacon_t;
+
+typedef struct {
+    sensormsg_type_t type;
+    union {
+        sensormsg_report_t report;
+        sensormsg_telemetry_t telemetry;
+        sensormsg_alert_t alert;
+        sensormsg_beacon_t beacon;
+    };
+} sensormsg_t;
+
+// ramec ze senzoru zapsany hex znaky (mezery se preskakuji), vraci pocet bytu nebo -1
+int sensormsg_parse_hex(const char *text, uint8_t *frame, size_t maxlen);
+
+// desifruje / zasifruje jeden 8B blok na miste
+void sensormsg_decrypt_block(uint8_t *block);
+void sensormsg_encrypt_block(uint8_t *block);
+// XOR dat s keystreamem CTR (speck_ctr_keystream v encrypt.S) - sifrovani i desifrovani
+// msg_ctr je 24bit citac zprav z otevrene hlavicky
+void sensormsg_ctr_xor(uint8_t *data, size_t len, uint8_t sensor_id, uint32_t msg_ctr, uint8_t domain);
+
+// ramec jako rf_send v sender.S: [delka] data [CRC8] do frame[len + 2], vraci jeho delku
+size_t sensormsg_frame(const uint8_t *payload, size_t len, uint8_t *frame);
+// overi delku a CRC ramce, vraci ukazatel na data a jejich delku, nebo NULL
+const uint8_t *sensormsg_unframe(const uint8_t *frame, size_t len, size_t *payload_len);
+
+// desifruje a rozlozi data ramce (payload se prepise), vraci typ zpravy
+sensormsg_type_t sensormsg_decode(uint8_t *payload, size_t len, sensormsg_t *msg);
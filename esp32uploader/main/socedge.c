@@ -0,0 +1,209 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/message_buffer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "sockhelper.h"
+#include "edgetrace.h"
+#include "metrics.h"
+#include "socedge.h"
+
+#include "driver/rmt_rx.h"
+
+#define TAG "SOCEDGE"
+
+#define RMT_CLK_HZ          1000000
+#define EDGE_RX_SYMBOLS     256         // buffer pro rmt_receive - s en_partial_rx se pouziva dokola
+#define EDGE_BUFFER_SIZE    16384       // ISR -> task
+#define EDGE_SEND_SIZE      1024
+#define EDGE_RANGE_MIN_NS   3000        // kratsi zakmity RMT odfiltruje
+#define EDGE_RANGE_MAX_NS   30000000    // delsi klid ukonci prijem, cas do dalsiho dopocitame
+
+typedef struct {
+    uint8_t is_last;
+    uint16_t count;
+    uint32_t time_us;           // cas volani callbacku - konec symbolu
+    rmt_symbol_word_t symbols[EDGE_RX_SYMBOLS];
+} edge_chunk_t;
+
+#define EDGE_CHUNK_HEADER offsetof(edge_chunk_t, symbols)
+
+static MessageBufferHandle_t _buffer;
+static volatile uint32_t _dropped;
+static rmt_symbol_word_t _rx_symbols[EDGE_RX_SYMBOLS];
+
+static bool IRAM_ATTR on_recv_done(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *data, void *ctx) {
+    static edge_chunk_t chunk;
+    BaseType_t woken = pdFALSE;
+    size_t count = data->num_symbols < EDGE_RX_SYMBOLS ? data->num_symbols : EDGE_RX_SYMBOLS;
+
+    chunk.is_last = data->flags.is_last;
+    chunk.count = count;
+    chunk.time_us = esp_timer_get_time();
+    memcpy(chunk.symbols, data->received_symbols, count * sizeof(rmt_symbol_word_t));
+
+    size_t len = EDGE_CHUNK_HEADER + count * sizeof(rmt_symbol_word_t);
+    if (xMessageBufferSendFromISR(_buffer, &chunk, len, &woken) != len) _dropped++;
+    return woken == pdTRUE;
+}
+
+typedef struct {
+    int sock;
+    bool header_sent;
+    uint8_t channel;
+    edgetrace_writer_t writer;
+    uint8_t buf[EDGE_SEND_SIZE];
+    size_t len;
+    uint32_t bytes;
+} edge_out_t;
+
+static int out_flush(edge_out_t *out) {
+    if (out->len && send(out->sock, out->buf, out->len, 0) != out->len) return -1;
+    out->bytes += out->len;
+    out->len = 0;
+    return 0;
+}
+
+// hlavicku posleme az s prvnim usekem - jeho uroven je first_level
+static int out_span(edge_out_t *out, uint8_t level, uint32_t ticks) {
+    if (!ticks) return 0;
+    if (!out->header_sent) {
+        edgetrace_header_t header = {
+            .channel = out->channel,
+            .first_level = level ? 1 : 0,
+            .resolution_hz = RMT_CLK_HZ,
+            .time = time(NULL),
+        };
+        out->len = edgetrace_write_header(&header, out->buf);
+        edgetrace_writer_init(&out->writer, header.first_level);
+        out->header_sent = true;
+    }
+    if (out->len + 2 * EDGETRACE_MAX_ITEM_LEN > sizeof(out->buf) && out_flush(out)) return -1;
+    out->len += edgetrace_writer_add(&out->writer, level, ticks, out->buf + out->len);
+    return 0;
+}
+
+static int do_edge(int sock) {
+    static edge_chunk_t chunk;
+    static edge_out_t out;
+    char line[32], name[4];
+    unsigned seconds;
+
+    if (socket_read_line(sock, line, sizeof(line)) < 0 || sscanf(line, "%3s %u", name, &seconds) != 2 ||
+        (strcmp(name, "IR") && strcmp(name, "RF")) || !seconds || seconds > EDGE_MAX_SECONDS) {
+        socket_printf(sock, "ERR pouziti: IR|RF <s>\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool ir = !strcmp(name, "IR");
+    // IR prijimac je v klidu v 1 (0 je nosna), prijimac 433 MHz v 0
+    uint8_t idle_level = ir ? 1 : 0;
+
+    rmt_rx_channel_config_t rx_cfg = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .gpio_num = ir ? EDGE_IR_PIN : EDGE_RF_PIN,
+        .mem_block_symbols = 48,
+        .resolution_hz = RMT_CLK_HZ,
+    };
+    rmt_receive_config_t receive_cfg = {
+        .signal_range_min_ns = EDGE_RANGE_MIN_NS,
+        .signal_range_max_ns = EDGE_RANGE_MAX_NS,
+        .flags.en_partial_rx = true,
+    };
+    rmt_rx_event_callbacks_t callbacks = {
+        .on_recv_done = on_recv_done,
+    };
+
+    rmt_channel_handle_t rx_channel;
+    esp_err_t err = rmt_new_rx_channel(&rx_cfg, &rx_channel);
+    if (err != ESP_OK) {
+        socket_printf(sock, "ERR %s\n", esp_err_to_name(err));
+        return err;
+    }
+    ESP_ERROR_CHECK(rmt_rx_register_event_callbacks(rx_channel, &callbacks, NULL));
+    ESP_ERROR_CHECK(rmt_enable(rx_channel));
+
+    memset(&out, 0, sizeof(out));
+    out.sock = sock;
+    out.channel = ir ? EDGETRACE_IR : EDGETRACE_RF;
+    xMessageBufferReset(_buffer);
+    _dropped = 0;
+
+    ESP_LOGI(TAG, "Zaznam %s na %d s", name, seconds);
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t end_us = start_us + seconds * 1000000LL;
+    int64_t signal_end_us = start_us;   // konec zapsaneho signalu
+    uint32_t dropped = 0;
+    bool receiving = false;
+
+    while (esp_timer_get_time() < end_us) {
+        if (!receiving) {
+            // prijem skoncil dlouhym klidem - znovu spustit, mezeru doplni cas dalsiho useku
+            if (rmt_receive(rx_channel, _rx_symbols, sizeof(_rx_symbols), &receive_cfg) != ESP_OK) break;
+            receiving = true;
+        }
+
+        size_t len = xMessageBufferReceive(_buffer, &chunk, sizeof(chunk), pdMS_TO_TICKS(100));
+        if (!len) continue;
+        if (chunk.is_last) receiving = false;
+
+        if (_dropped != dropped) {
+            metric_add(METRIC_EDGE_DROPPED, _dropped - dropped);
+            dropped = _dropped;
+            edgetrace_writer_break(&out.writer);
+        }
+
+        uint32_t duration = 0;
+        for (size_t i = 0; i < chunk.count; i++) duration += chunk.symbols[i].duration0 + chunk.symbols[i].duration1;
+
+        // posledni blok se hlasi az po EDGE_RANGE_MAX_NS klidu
+        int64_t chunk_end_us = chunk.time_us - (chunk.is_last ? EDGE_RANGE_MAX_NS / 1000 : 0);
+        int64_t chunk_start_us = chunk_end_us - duration;
+        if (chunk_start_us > signal_end_us && out_span(&out, idle_level, chunk_start_us - signal_end_us)) break;
+
+        int failed = 0;
+        for (size_t i = 0; i < chunk.count && !failed; i++) {
+            failed = out_span(&out, chunk.symbols[i].level0, chunk.symbols[i].duration0) ||
+                     out_span(&out, chunk.symbols[i].level1, chunk.symbols[i].duration1);
+        }
+        if (failed) break;
+        if (chunk_end_us > signal_end_us) signal_end_us = chunk_end_us;
+        // zbytek posilame az s plnym bufferem nebo na konci
+        if (out.len > sizeof(out.buf) / 2 && out_flush(&out)) break;
+    }
+
+    rmt_disable(rx_channel);
+    rmt_del_channel(rx_channel);
+
+    if (out.header_sent) {
+        out.len += edgetrace_writer_flush(&out.writer, out.buf + out.len);
+        out_flush(&out);
+    }
+
+    ESP_LOGI(TAG, "Zaznam %s: %" PRIu32 " B, %" PRIu32 " ztracenych bloku", name, out.bytes, dropped);
+    return ESP_OK;
+}
+
+void edge_socket_server_init(int socket_port) {
+    ESP_LOGI(TAG, "Spoustim zaznam hran...");
+
+    _buffer = xMessageBufferCreate(EDGE_BUFFER_SIZE);
+
+    socket_server_params *params = malloc(sizeof(socket_server_params));
+    params->port = socket_port;
+    params->handler = do_edge;
+    params->redirect_stdout = false;
+    params->redirect_stdin = false;
+    params->upload_ready = false;
+
+    xTaskCreate(socket_server, "edge_socket_server", 4096, params, 5, NULL);
+}
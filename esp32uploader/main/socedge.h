@@ -0,0 +1,13 @@
+#pragma once
+
+// Zaznam hran z IR nebo 433 MHz prijimace pres RMT RX - pro ladeni prijmu mimo senzor.
+// Na port edge_socket_server_init se posle radek "IR <s>" nebo "RF <s>", brana pak po zadanou dobu
+// posila zaznam ve formatu edgetrace.h a spojeni zavre:
+//   echo "RF 60" | ncat esp 9993 > rf.edg; sim/edgereplay rf.edg
+// Zaznam jde rovnou do soketu, ve flash se neuklada. Co se nestihne odeslat, je v zaznamu jako preruseni.
+
+#define EDGE_IR_PIN         3       // vystup IR prijimace - podle zapojeni
+#define EDGE_RF_PIN         4       // datovy vystup prijimace 433 MHz - podle zapojeni
+#define EDGE_MAX_SECONDS    600
+
+void edge_socket_server_init(int socket_port);
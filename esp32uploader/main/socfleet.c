@@ -0,0 +1,124 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "sockhelper.h"
+#include "irframe.h"
+#include "fwstore.h"
+#include "rollout.h"
+#include "socfleet.h"
+
+#define TAG "SOCFLEET"
+
+static int parse_id(const char *s, char **end) {
+    long id = strtol(s, end, 0);
+    return *end != s && id >= 0 && id <= 255 ? id : -1;
+}
+
+static int do_put(int sock, const char *args) {
+    static uint8_t image[IRFRAME_FLASH_LIMIT];
+    static irframe_hex_t hex;
+    uint8_t buf[512];
+    unsigned id, version;
+    size_t len = 0;
+    int read_bytes;
+    bool is_hex = false;
+
+    if (sscanf(args, "%u %i", &id, &version) != 2 || id > 255 || version > 255) {
+        socket_printf(sock, "ERR pouziti: PUT <id> <verze>\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // binarni obraz nebo primo main.hex
+    memset(image, 0xFF, sizeof(image));
+    irframe_hex_init(&hex, image, sizeof(image));
+
+    while ((read_bytes = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        if (!len && !is_hex && buf[0] == ':') is_hex = true;
+        if (is_hex) {
+            if (irframe_hex_feed(&hex, buf, read_bytes) != IRFRAME_HEX_MORE) break;
+            continue;
+        }
+        if (len + read_bytes > sizeof(image)) {
+            // prilis velky obraz by prepsal bootloader
+            socket_printf(sock, "ERR obraz je vetsi nez %d B\n", IRFRAME_FLASH_LIMIT);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(image + len, buf, read_bytes);
+        len += read_bytes;
+    }
+
+    if (is_hex) {
+        if (irframe_hex_finish(&hex) != IRFRAME_HEX_DONE) {
+            socket_printf(sock, "ERR chybny HEX na radku %" PRIu32 "\n", hex.line_no);
+            return ESP_ERR_INVALID_ARG;
+        }
+        len = hex.end;
+    }
+
+    esp_err_t err = fwstore_put(id, version, image, len, is_hex ? hex.used : NULL);
+    if (err == ESP_OK) socket_printf(sock, "OK %u B\n", (unsigned)len);
+    else socket_printf(sock, "ERR %s\n", esp_err_to_name(err));
+    return err;
+}
+
+static void list_image(const fwstore_info_t *info, void *ctx) {
+    socket_printf(*(int *)ctx, "%d 0x%02X %u %" PRIu32 "\n", info->sensor_id, info->version, info->len, info->time);
+}
+
+static void list_status(const rollout_status_t *status, void *ctx) {
+    socket_printf(*(int *)ctx, "%d %s 0x%02X %d %" PRIu32 " %s\n", status->sensor_id,
+                  rollout_state_name(status->state), status->version, status->attempts, status->time,
+                  status->last_err == ESP_OK ? "-" : esp_err_to_name(status->last_err));
+}
+
+static int do_fleet(int sock) {
+    char line[128];
+    char *args, *end;
+    int id;
+
+    if (socket_read_line(sock, line, sizeof(line)) < 0) return -1;
+    args = strchr(line, ' ');
+    args = args ? args + 1 : line + strlen(line);
+
+    if (!strncmp(line, "PUT ", 4)) return do_put(sock, args);
+
+    if (!strcmp(line, "LIST")) {
+        fwstore_list(list_image, &sock);
+    } else if (!strcmp(line, "STATUS")) {
+        rollout_list(list_status, &sock);
+    } else if (!strncmp(line, "DELETE ", 7) && (id = parse_id(args, &end)) >= 0) {
+        esp_err_t err = fwstore_delete(id);
+        socket_printf(sock, "%s %d\n", err == ESP_OK ? "OK" : esp_err_to_name(err), id);
+    } else if (!strncmp(line, "BOOT ", 5) && (id = parse_id(args, &end)) >= 0) {
+        esp_err_t err = rollout_enter_bootloader(id);
+        socket_printf(sock, "%s %d\n", err == ESP_OK ? "READY" : esp_err_to_name(err), id);
+    } else if (!strncmp(line, "ROLLOUT ", 8)) {
+        while ((id = parse_id(args, &end)) >= 0) {
+            esp_err_t err = rollout_enqueue(id);
+            socket_printf(sock, "%s %d\n", err == ESP_OK ? "OK" : esp_err_to_name(err), id);
+            args = end;
+        }
+    } else {
+        socket_printf(sock, "ERR neznamy prikaz\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+void fleet_socket_server_init(int socket_port) {
+    socket_server_params *params = malloc(sizeof(socket_server_params));
+    params->port = socket_port;
+    params->handler = do_fleet;
+    params->redirect_stdout = false;
+    params->redirect_stdin = false;
+    params->upload_ready = false;
+
+    xTaskCreate(socket_server, "fleet_socket_server", 4096, params, 4, NULL);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Sprava obrazu a aktualizaci senzoru, jeden prikaz na spojeni:
+//   PUT <id> <verze>\n<obraz>          ulozi obraz (do konce spojeni) - binarni nebo Intel HEX
+//   LIST                               ulozene obrazy
+//   DELETE <id>                        smaze obraz
+//   ROLLOUT <id> [<id> ...]            zaradi senzory do fronty aktualizaci
+//   BOOT <id>                          prepne senzor (255 vsechny) do bootloaderu, odpovi READY po beaconu
+//   STATUS                             stav fronty
+void fleet_socket_server_init(int socket_port);
@@ -11,6 +11,11 @@
 #include "lwip/sys.h"
 #include "sockhelper.h"
 #include "socirnec.h"
+#include "socrf.h"
+#include "irframe.h"
+#include "metrics.h"
+#include "util.h"
+#include "esp_timer.h"
 
 #include <driver/gpio.h>
 
@@ -100,8 +105,6 @@ out:
 }
 
 static esp_err_t rmt_del_nec_protocol_encoder(rmt_encoder_t *encoder) {
-    ESP_LOGI(TAG, "DELETING NEC ENCODER");
-
     rmt_nec_protocol_encoder_t *nec_encoder = __containerof(encoder, rmt_nec_protocol_encoder_t, base);
     rmt_del_encoder(nec_encoder->copy_encoder);
     rmt_del_encoder(nec_encoder->bytes_encoder);
@@ -149,14 +152,12 @@ static void send_buffer_with_rmt(uint8_t *buf, size_t len) {
     ESP_ERROR_CHECK(rmt_new_nec_protocol_encoder(&nec_encoder));
     ESP_ERROR_CHECK(rmt_enable(tx_channel));
 
-    ESP_LOGI(TAG, "modulate carrier to TX channel");
     rmt_carrier_config_t carrier_cfg = {
         .duty_cycle = (float)CARRIER_DUTY / 100.0f,
         .frequency_hz = CARRIER_FREQ_HZ,
     };
     ESP_ERROR_CHECK(rmt_apply_carrier(tx_channel, &carrier_cfg));
 
-    ESP_LOGI(TAG, "Sending %d bytes via IR UART...", (int)len);
     rmt_transmit_config_t transmit_config = {
         .loop_count = 0,
         .flags = {
@@ -164,10 +165,14 @@ static void send_buffer_with_rmt(uint8_t *buf, size_t len) {
         }
     };
 
+    int64_t start = esp_timer_get_time();
     ESP_ERROR_CHECK(rmt_transmit(tx_channel, nec_encoder, buf, len, &transmit_config));
     ESP_ERROR_CHECK(rmt_tx_wait_all_done(tx_channel, portMAX_DELAY));
 
-    ESP_LOGI(TAG, "Transmission complete.");
+    uint32_t duration = esp_timer_get_time() - start;
+    metric_observe(METRIC_IRNEC_RMT_US, duration);
+    metric_add(METRIC_IRNEC_BUSY_US, duration);
+    metric_add(METRIC_IRNEC_BYTES, len);
 
     ESP_ERROR_CHECK(rmt_disable(tx_channel));
     ESP_ERROR_CHECK(rmt_del_channel(tx_channel));
@@ -175,11 +180,58 @@ static void send_buffer_with_rmt(uint8_t *buf, size_t len) {
     ESP_ERROR_CHECK(rmt_del_nec_protocol_encoder(nec_encoder));
 }
 
+// Textovy prikaz pro nastaveni senzoru (viz example/motionrx/settings.h) prevede na binarni ramec s CRC8:
+//   "G <id> <key>", "S <id> <key> <value>", "B <id>" - vse 0-255, senzor ma jednobytove hodnoty
+// Vraci delku ramce, 0 pokud nejde o textovy prikaz - pak se posila jak je (napr. "BOOT"),
+// nebo -1 pro prikaz se spatnymi parametry - ten se neposila, senzor by jinak dostal orezane cislo.
+int irnec_build_command(const uint8_t *text, size_t len, uint8_t *frame) {
+    char line[32];
+    unsigned id = 0, key = 0, value = 0;
+    char cmd;
+    int n;
+
+    if (len < 3 || len >= sizeof(line) || text[1] != ' ') return 0;
+    memcpy(line, text, len);
+    line[len] = 0;
+
+    switch (text[0]) {
+        case 'G': n = sscanf(line, "%c %u %u", &cmd, &id, &key) == 3 ? 3 : 0; break;
+        case 'S': n = sscanf(line, "%c %u %u %u", &cmd, &id, &key, &value) == 4 ? 4 : 0; break;
+        case 'B': n = sscanf(line, "%c %u", &cmd, &id) == 2 ? 2 : 0; break;
+        default: return 0;
+    }
+    if (!n || id > 0xFF || key > 0xFF || value > 0xFF) return -1;
+
+    frame[0] = id;
+    frame[1] = cmd;
+    frame[2] = key;
+    frame[3] = value;
+
+    uint8_t crc = 0;
+    for (int i = 0; i < n; i++) crc = irframe_crc8(crc, frame[i]);
+    frame[n] = crc;
+    return n + 1;
+}
+
+// Vse, co jde do IR NEC - prikaz do bootloaderu ("B <id>" z irnec_send_command i soketu, nebo "BOOT")
+// zacne znovu sbirat beacony: HEX na portu irtx se koduje jen podle beaconu, ktere prijdou az po nem.
+static void transmit(uint8_t *buf, size_t len) {
+    if ((len == 3 && buf[1] == 'B') || (len == 4 && !memcmp(buf, "BOOT", 4))) rf_boot_sent();
+
+    TRACE_HEX(TAG, buf, len);
+
+    ir_tx_lock();
+    send_buffer_with_rmt(buf, len);
+    ir_tx_unlock();
+}
+
 static int do_irtx_update(int sock) {
     int read_bytes = 0;
     size_t tx_buf_len = 0;
     uint8_t tx_buf[512];
 
+    metric_add(METRIC_IRNEC_SESSIONS, 1);
+
     while (tx_buf_len < 512 && (read_bytes = recv(sock, tx_buf + tx_buf_len, 512 - tx_buf_len, 0)) > 0) {
         tx_buf_len += read_bytes;
     }
@@ -188,14 +240,31 @@ static int do_irtx_update(int sock) {
         ESP_LOGW(TAG, "Buffer plný, možná nekompletní data.");
     }
 
-    ESP_LOGI(TAG, "Sending %d bytes...", tx_buf_len);
+    uint8_t frame[8];
+    int frame_len = irnec_build_command(tx_buf, tx_buf_len, frame);
+    if (frame_len < 0) {
+        ESP_LOGW(TAG, "Neplatny prikaz (id, key i hodnota 0-255), neodvysilano");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (frame_len) {
+        memcpy(tx_buf, frame, frame_len);
+        tx_buf_len = frame_len;
+    }
+
+    transmit(tx_buf, tx_buf_len);
 
-    ESP_LOG_BUFFER_HEX(TAG, tx_buf, tx_buf_len);
+    ESP_LOGI(TAG, "Odvysilano %d bytu", tx_buf_len);
 
-    send_buffer_with_rmt(tx_buf, tx_buf_len);
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "... finished");
+esp_err_t irnec_send_command(const char *text) {
+    uint8_t frame[8];
+    int len = irnec_build_command((const uint8_t *)text, strlen(text), frame);
+    if (len <= 0) return ESP_ERR_INVALID_ARG;
 
+    metric_add(METRIC_IRNEC_SESSIONS, 1);
+    transmit(frame, len);
     return ESP_OK;
 }
 
@@ -223,6 +292,7 @@ void irnec_socket_writer_init(int speed, int pin, int socket_port) {
     params->handler = do_irtx_update;
     params->redirect_stdout = false;
     params->redirect_stdin = false;
+    params->upload_ready = false;
 
     xTaskCreate(socket_server, "irnec_socket_server", 12000, params, 5, NULL);
 }
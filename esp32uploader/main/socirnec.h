@@ -1,3 +1,13 @@
 #pragma once
 
-void irnec_socket_writer_init(int speed, int pin, int socket_port);
\ No newline at end of file
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+void irnec_socket_writer_init(int speed, int pin, int socket_port);
+
+// textovy prikaz "G id key" / "S id key value" / "B id" na binarni ramec, 0 = neni prikaz,
+// -1 = prikaz s hodnotou mimo 0-255
+int irnec_build_command(const uint8_t *text, size_t len, uint8_t *frame);
+// odvysila textovy prikaz (viz irnec_build_command)
+esp_err_t irnec_send_command(const char *text);
@@ -11,6 +11,11 @@
 #include "lwip/sys.h"
 #include "sockhelper.h"
 #include "socirtx.h"
+#include "irframe.h"
+#include "socrf.h"
+#include "metrics.h"
+#include "util.h"
+#include "esp_timer.h"
 
 #include <driver/gpio.h>
 
@@ -25,12 +30,11 @@
 
 static int _pin;
 static int _speed;
+static socket_server_params *_params;
 
 static uint8_t tx_buffer[BUF_SIZE] = {0};
 
 static void send_buffer_with_rmt(uint8_t *buf, size_t len) {
-    esp_log_level_set("*", ESP_LOG_DEBUG);
-
     rmt_tx_channel_config_t tx_cfg = {
         .clk_src = RMT_CLK_SRC_DEFAULT,
         .gpio_num = _pin,
@@ -72,8 +76,6 @@ static void send_buffer_with_rmt(uint8_t *buf, size_t len) {
     rmt_encoder_handle_t encoder = NULL;
     ESP_ERROR_CHECK(rmt_new_bytes_encoder(&bytes_encoder_config, &encoder));
 
-    ESP_LOGI(TAG, "Sending %d bytes via IR UART...", (int)len);
-
     rmt_transmit_config_t transmit_config = {
         .loop_count = 0,
         .flags = {
@@ -81,71 +83,88 @@ static void send_buffer_with_rmt(uint8_t *buf, size_t len) {
         }
     };
 
+    int64_t start = esp_timer_get_time();
     ESP_ERROR_CHECK(rmt_transmit(tx_channel, encoder, buf, len, &transmit_config));
     ESP_ERROR_CHECK(rmt_tx_wait_all_done(tx_channel, portMAX_DELAY));
 
-    ESP_LOGI(TAG, "Transmission complete.");
+    uint32_t duration = esp_timer_get_time() - start;
+    metric_observe(METRIC_IRTX_RMT_US, duration);
+    metric_add(METRIC_IRTX_BUSY_US, duration);
+    metric_add(METRIC_IRTX_BYTES, len);
 
     ESP_ERROR_CHECK(rmt_disable(tx_channel));
     ESP_ERROR_CHECK(rmt_del_channel(tx_channel));
 }
 
-static uint8_t nimbble_symbols[] =
-{
-    0xd, 0xe, 0x13, 0x15, 0x16, 0x19, 0x1a, 0x1c,
-    0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34
-};
-
-static uint8_t nibblify_stream(uint8_t *src, size_t srclen, uint8_t *dest, size_t destlen) {
-    size_t dest_ix = 0;
-
-    for (int i = 0; i < srclen; i += 2) {
-        uint8_t a = nimbble_symbols[src[i] >> 4];
-        uint8_t b = nimbble_symbols[src[i] & 0x0f];
-        uint8_t c = 0;
-        uint8_t d = 0;
-        if (i + 1 < srclen) {
-            c = nimbble_symbols[src[i + 1] >> 4];
-            d = nimbble_symbols[src[i + 1] & 0x0f];
-        }
+static int do_irtx_hex(int sock) {
+    static uint8_t image[IRFRAME_FLASH_LIMIT];
+    static irframe_hex_t hex;
+    uint8_t buf[512];
+    int read_bytes;
 
-        uint8_t x = a << 2 | b >> 4;
-        uint8_t y = b << 4 | c >> 2;
-        uint8_t z = c << 6 | d;
+    memset(image, 0xFF, sizeof(image));
+    irframe_hex_init(&hex, image, sizeof(image));
 
-        if (destlen - dest_ix < 3) return 0;
+    while ((read_bytes = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        if (irframe_hex_feed(&hex, buf, read_bytes) != IRFRAME_HEX_MORE) break;
+    }
 
-        dest[dest_ix++] = x;
-        dest[dest_ix++] = y;
-        dest[dest_ix++] = z;
+    if (irframe_hex_finish(&hex) != IRFRAME_HEX_DONE) {
+        ESP_LOGE(TAG, "Chybny HEX na radku %" PRIu32, hex.line_no);
+        metric_add(METRIC_IRTX_ERRORS, 1);
+        return ESP_ERR_INVALID_ARG;
     }
-    return dest_ix;
+
+    // kodovani podle beaconu bootloaderu po "B <id>" nebo "BOOT" - bez nich 4b6b
+    irframe_code_t code = rf_boot_line_code();
+    ESP_LOGI(TAG, "HEX: %u B, %s", (unsigned)hex.end, code == IRFRAME_CODE_NRZ ? "NRZ" : "4b6b");
+    metric_observe(METRIC_IRTX_ACCEPT_US, esp_timer_get_time() - _params->accepted_us);
+    return irtx_send_image(image, hex.end, hex.used, code);
 }
 
 static int do_irtx_update(int sock) {
     int read_bytes = 0;
     size_t tx_buf_len = 0;
-    uint8_t synchro_len = 12;
     uint8_t buf[512];
 
+    // main.hex primo - stranky a ramce sestavime sami
+    if (recv(sock, buf, 1, MSG_PEEK) == 1 && buf[0] == ':') return do_irtx_hex(sock);
+
+    metric_add(METRIC_IRTX_SESSIONS, 1);
+
     // Pripravime preambuli - synchronizace 01 01 01 01 01 ... musi jich byt (12*x - 4) / 8 bytu
-    memset(tx_buffer, 0xCC, synchro_len); // 16 dvojic 01 - 32 bitu
-    tx_buf_len = synchro_len;
+    memset(tx_buffer, IRFRAME_PREAMBLE_BYTE, IRFRAME_PREAMBLE_LEN); // 16 dvojic 01 - 32 bitu
+    tx_buf_len = IRFRAME_PREAMBLE_LEN;
     // tx_buffer[tx_buf_len++] = 0x38; // 0x38;
     // tx_buffer[tx_buf_len++] = 0xAB;
 
-    // nacteme START symbol
-    tx_buf_len += recv(sock, tx_buffer+tx_buf_len, 4, 0);
+    // nacteme START symbol - "FN" misto "FU" vybere NRZ (irframe.h)
+    tx_buf_len += recv(sock, tx_buffer+tx_buf_len, IRFRAME_START_LEN, 0);
+    bool nrz = !memcmp(tx_buffer + IRFRAME_PREAMBLE_LEN, irframe_start_symbol_nrz, IRFRAME_START_LEN);
+    uint8_t scrambler = IRFRAME_SCRAMBLER_SEED;
 
     size_t offset = 0;
     // pozor u zprav predpokladame, ze jsou vzdy ve wordech
     while ((read_bytes = recv(sock, buf + offset, 512 - offset, 0)) > 0) {
+        if (nrz) {
+            // NRZ po bytech - skrambler pokracuje pres hranice kusu
+            if ((size_t)read_bytes > BUF_SIZE - tx_buf_len) {
+                ESP_LOGE(TAG, "Zprava se nevejde do bufferu, aborting");
+                metric_add(METRIC_IRTX_ERRORS, 1);
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(tx_buffer + tx_buf_len, buf, read_bytes);
+            irframe_scramble(&scrambler, tx_buffer + tx_buf_len, read_bytes);
+            tx_buf_len += read_bytes;
+            continue;
+        }
         offset += read_bytes;
-        if (offset % 1) continue;
-        size_t nibbles_count = nibblify_stream(buf, offset, tx_buffer + tx_buf_len, BUF_SIZE - tx_buf_len);
+        if (offset % 2) continue;
+        size_t nibbles_count = irframe_nibblify(buf, offset, tx_buffer + tx_buf_len, BUF_SIZE - tx_buf_len);
         offset = 0;
         if (!nibbles_count) {
             ESP_LOGE(TAG, "Failed to encode nibbles, aborting");
+            metric_add(METRIC_IRTX_ERRORS, 1);
             return ESP_ERR_INVALID_ARG;
         }
         tx_buf_len += nibbles_count;
@@ -153,23 +172,55 @@ static int do_irtx_update(int sock) {
 
     if (offset) {
         ESP_LOGE(TAG, "Failed to encode last nibbles - message need to be word aligned, aborting");
+        metric_add(METRIC_IRTX_ERRORS, 1);
         return ESP_ERR_INVALID_ARG;
     }
 
     if (read_bytes < 0) {
         ESP_LOGE(TAG, "Error reading data from socket: errno %d", errno);
+        metric_add(METRIC_IRTX_ERRORS, 1);
         return errno;
     }
 
-    ESP_LOGI(TAG, "Sending %d bytes...", tx_buf_len);
+    TRACE_HEX(TAG, tx_buffer, tx_buf_len);
 
-    ESP_LOG_BUFFER_HEX(TAG, tx_buffer, tx_buf_len);
+    ir_tx_lock();
+    metric_observe(METRIC_IRTX_ACCEPT_US, esp_timer_get_time() - _params->accepted_us);
+    send_buffer_with_rmt(tx_buffer, tx_buf_len);
+    ir_tx_unlock();
 
+    ESP_LOGI(TAG, "Odvysilano %d bytu", tx_buf_len);
 
-    send_buffer_with_rmt(tx_buffer, tx_buf_len);
+    return ESP_OK;
+}
+
+esp_err_t irtx_send_image(const uint8_t *image, size_t len, const uint8_t *used, irframe_code_t code) {
+    uint8_t page_tx[IRFRAME_PAGE_TX_LEN];   // NRZ je kratsi
+    uint8_t page[IRFRAME_PAGE_SIZE];
+    size_t pages = (len + IRFRAME_PAGE_SIZE - 1) / IRFRAME_PAGE_SIZE;
+    size_t sent = irframe_pages_to_send(used, len);
+    size_t index = sent;
 
-    ESP_LOGI(TAG, "... finished");
+    if (!index || len > IRFRAME_FLASH_LIMIT) return ESP_ERR_INVALID_SIZE;
+
+    metric_add(METRIC_IRTX_SESSIONS, 1);
+
+    // stranky vzestupne, index klesa k 1 - po posledni strance bootloader spusti program
+    ir_tx_lock();
+    for (size_t p = 0; p < pages; p++) {
+        if (!irframe_page_used(used, p)) continue;
+
+        size_t n = len - p * IRFRAME_PAGE_SIZE < IRFRAME_PAGE_SIZE ? len - p * IRFRAME_PAGE_SIZE : IRFRAME_PAGE_SIZE;
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, image + p * IRFRAME_PAGE_SIZE, n);
+
+        size_t tx_len = irframe_encode_page(p * IRFRAME_PAGE_SIZE, index--, page, code, page_tx, sizeof(page_tx));
+        TRACE_HEX(TAG, page_tx, tx_len);
+        send_buffer_with_rmt(page_tx, tx_len);
+    }
+    ir_tx_unlock();
 
+    ESP_LOGI(TAG, "Odvysilano %u stranek, %u mimo HEX vynechano", (unsigned)sent, (unsigned)(pages - sent));
     return ESP_OK;
 }
 
@@ -189,10 +240,12 @@ void irtx_socket_writer_init(int speed, int pin, int socket_port) {
     ESP_ERROR_CHECK(gpio_config(&io_conf));
 
     socket_server_params *params = malloc(sizeof(socket_server_params));
+    _params = params;
     params->port = socket_port;
     params->handler = do_irtx_update;
     params->redirect_stdout = false;
     params->redirect_stdin = false;
+    params->upload_ready = true;
 
     xTaskCreate(socket_server, "irtx_socket_server", 12000, params, 5, NULL);
 }
@@ -1,3 +1,13 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "irframe.h"
+
 void irtx_socket_writer_init(int speed, int pin, int socket_port);
+
+// odvysila obraz flash od adresy 0 po strankach pro bootloader - senzor uz musi byt v bootloaderu;
+// used - bitmapa stranek z irframe_hex_t (NULL posle vse), viz irframe_page_used;
+// IRFRAME_CODE_NRZ jen pro bootloader, ktery poslal beacon 'N' (rf_beacon_line_code, rf_boot_line_code)
+esp_err_t irtx_send_image(const uint8_t *image, size_t len, const uint8_t *used, irframe_code_t code);
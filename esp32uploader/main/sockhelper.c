@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_sleep.h"
@@ -11,7 +12,10 @@
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
+#include "esp_timer.h"
 #include "sockhelper.h"
+#include "metrics.h"
+#include "wifi.h"
 
 // https://github.com/NyankoLab/esp32c3-elf
 // TODO predelat podle: https://components.espressif.com/components/espressif/elf_loader/versions/1.0.0
@@ -20,9 +24,7 @@
 
 #define EXEC_BUF_LEN 8192
 
-void socket_server(void *pvParameter) {
-    socket_server_params *params = pvParameter;
-
+int socket_listen(int port, int backlog) {
     int server_fd = 0;
 
     struct sockaddr_storage dest_addr;
@@ -30,11 +32,11 @@ void socket_server(void *pvParameter) {
 
     dest_addr_ip4->sin_addr.s_addr = htonl(INADDR_ANY);
     dest_addr_ip4->sin_family = AF_INET;
-    dest_addr_ip4->sin_port = htons(params->port);
+    dest_addr_ip4->sin_port = htons(port);
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) == 0) {
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) < 0) {
         ESP_LOGE(TAG, "setsockopt selhal");
-        goto exit;
+        return -1;
     }
 
     int opt = 1;
@@ -51,15 +53,33 @@ void socket_server(void *pvParameter) {
         goto exit;
     }
 
-    ESP_LOGI(TAG, "Socket server bound, port %d", params->port);
+    ESP_LOGI(TAG, "Socket server bound, port %d", port);
 
-    err = listen(server_fd, 1);
+    err = listen(server_fd, backlog);
     if (err != 0) {
         ESP_LOGE(TAG, "Error occurred during listen: errno %d", errno);
-        goto exit;;
+        goto exit;
     }
 
-    ESP_LOGI(TAG, "Server je připraven a poslouchá na portu %d\n", params->port);
+    uint32_t ready_ms = esp_timer_get_time() / 1000;
+    ESP_LOGI(TAG, "Server je připraven a poslouchá na portu %d, %" PRIu32 " ms od startu\n", port, ready_ms);
+    return server_fd;
+
+exit:
+    close(server_fd);
+    return -1;
+}
+
+void socket_server(void *pvParameter) {
+    socket_server_params *params = pvParameter;
+
+    // task bezi hned po startu, soket otevreme az s IP
+    wait_wifi_connected(portMAX_DELAY);
+
+    int server_fd = socket_listen(params->port, 1);
+    if (server_fd < 0) goto exit;
+
+    if (params->upload_ready) metric_gauge(METRIC_BOOT_TO_LISTEN_MS, esp_timer_get_time() / 1000);
 
     while (1) {
         printf("Čekám na nové připojení...\n");
@@ -71,6 +91,7 @@ void socket_server(void *pvParameter) {
             ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
             break;
         }
+        params->accepted_us = esp_timer_get_time();
 
         FILE *socket_in = NULL, *socket_out = NULL,
                 *original_stdin = stdin,
@@ -113,8 +134,39 @@ void socket_server(void *pvParameter) {
         close(new_socket);
     }
 
+    close(server_fd);
+
 exit:
-    if (server_fd) close(server_fd);
     free(params);
     vTaskDelete(NULL);
 }
+
+int socket_printf(int socket, const char *fmt, ...) {
+    char buf[160];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < 0) return len;
+    if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+    return send(socket, buf, len, 0);
+}
+
+int socket_read_line(int socket, char *line, size_t len) {
+    size_t n = 0;
+
+    line[0] = 0;
+    while (n < len - 1) {
+        int r = recv(socket, line + n, 1, 0);
+        if (r <= 0) {
+            if (!n) return -1;
+            break;
+        }
+        if (line[n] == '\n') break;
+        n++;
+    }
+    if (n && line[n - 1] == '\r') n--;
+    line[n] = 0;
+    return n;
+}
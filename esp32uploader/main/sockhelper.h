@@ -1,5 +1,9 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
 typedef int (*socket_server_handler)(int socket);
 
 typedef struct socket_server_params {
@@ -7,6 +11,14 @@ typedef struct socket_server_params {
     int port;
     bool redirect_stdout;
     bool redirect_stdin;
+    bool upload_ready;      // po otevreni soketu brana prijima nahravani senzoru - zapise boot_to_listen_ms
+    int64_t accepted_us;    // esp_timer_get_time() pri prijeti aktualniho spojeni
 } socket_server_params;
 
-void socket_server(void *pvParameter);
\ No newline at end of file
+void socket_server(void *pvParameter);
+// otevre naslouchajici TCP soket (vola se az s IP), vraci fd nebo -1
+int socket_listen(int port, int backlog);
+// formatovany text primo do soketu (bez presmerovani stdout)
+int socket_printf(int socket, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// nacte radek bez '\n', vraci jeho delku nebo -1
+int socket_read_line(int socket, char *line, size_t len);
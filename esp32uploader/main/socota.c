@@ -13,6 +13,8 @@
 #include "esp_ota_ops.h"
 #include "sockhelper.h"
 #include "socota.h"
+#include "metrics.h"
+#include "esp_timer.h"
 
 #define TAG "SOCOTA"
 #define OTA_BUF_SIZE 8192
@@ -22,9 +24,12 @@ static int do_ota_update(int sock) {
     int read_bytes = 0;
     char rx_buffer[OTA_BUF_SIZE];
 
+    metric_add(METRIC_OTA_SESSIONS, 1);
+
     const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
     if (!update_partition) {
         ESP_LOGE(TAG, "No OTA partition found");
+        metric_add(METRIC_OTA_ERRORS, 1);
         return ESP_FAIL;
     }
     ESP_LOGI(TAG, "Writing to partition: %s", update_partition->label);
@@ -32,6 +37,7 @@ static int do_ota_update(int sock) {
     int err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+        metric_add(METRIC_OTA_ERRORS, 1);
         return err;
     }
 
@@ -39,20 +45,27 @@ static int do_ota_update(int sock) {
 
     size_t offset = 0;
     while ((read_bytes = recv(sock, rx_buffer, OTA_BUF_SIZE, 0)) > 0) {
+        int64_t start = esp_timer_get_time();
         err = esp_ota_write(ota_handle, rx_buffer, read_bytes);
+        uint32_t duration = esp_timer_get_time() - start;
+        metric_observe(METRIC_OTA_WRITE_US, duration);
+        metric_add(METRIC_OTA_BUSY_US, duration);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(err));
             break;
         }
         offset += read_bytes;
-        ESP_LOGI(TAG, "Written %d bytes", offset);
+        metric_add(METRIC_OTA_BYTES, read_bytes);
     }
 
+    ESP_LOGI(TAG, "Written %d bytes", offset);
+
     if (read_bytes < 0) {
         ESP_LOGE(TAG, "Error reading data from socket: errno %d", errno);
     }
 
     err = esp_ota_end(ota_handle);
+    if (err != ESP_OK) metric_add(METRIC_OTA_ERRORS, 1);
     if (err == ESP_OK) {
         err = esp_ota_set_boot_partition(update_partition);
         if (err == ESP_OK) {
@@ -73,6 +86,7 @@ void init_ota_socket_server() {
     params->handler = do_ota_update;
     params->redirect_stdout = true;
     params->redirect_stdin = false;
+    params->upload_ready = false;
 
     xTaskCreate(socket_server, "ota_socket_server", 2*OTA_BUF_SIZE, params, 5, NULL);
 }
@@ -0,0 +1,422 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "sockhelper.h"
+#include "sensormsg.h"
+#include "metrics.h"
+#include "tsdb.h"
+#include "rollout.h"
+#include "rffusion.h"
+#include "wifi.h"
+#include "socrf.h"
+
+#define TAG "SOCRF"
+
+// kazdou zpravu senzor posila dvakrat a slysi ji vic prijimacu - dal jde jen prvni kopie
+static rffusion_t _fusion;
+static SemaphoreHandle_t _lock;
+
+// posledni poplach kazdeho senzoru - hlaseni se stejnym msg_id ho uzavre
+typedef struct {
+    bool pending;
+    uint16_t msg_id;
+    int64_t time_us;
+    bool reported;
+    uint16_t report_msg_id;     // posledni hlaseni - poplach musi mit novejsi msg_id
+} rf_alert_t;
+
+static rf_alert_t _alerts[256];
+
+static int _port;
+static uint32_t _beacon_count;
+static uint8_t _beacon_sensor_id;
+// kodovani, ktere umi bootloader senzoru - podle posledniho beaconu
+static uint8_t _beacon_nrz[256 / 8];
+// beacony od posledniho rf_boot_sent
+static uint32_t _boot_beacons;
+static bool _boot_4b6b;         // aspon jeden byl 'R'
+
+static uint32_t now_ms(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+static bool fusion_accept(int receiver, uint32_t key) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t evicted = _fusion.evicted;
+    bool first = rffusion_accept(&_fusion, receiver, key, now_ms());
+    evicted = _fusion.evicted - evicted;
+    xSemaphoreGive(_lock);
+
+    if (evicted) metric_add(METRIC_RF_FUSION_EVICTED, evicted);
+    return first;
+}
+
+static void fusion_error(int receiver) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    rffusion_error(&_fusion, receiver);
+    xSemaphoreGive(_lock);
+    metric_add(METRIC_RF_ERRORS, 1);
+}
+
+static void handle_report(const sensormsg_report_t *r) {
+    tsdb_sample_t sample = {
+        .time = time(NULL),
+        .sensor_id = r->sensor_id,
+        .msg_id = r->msg_id,
+        .tick = r->tick,
+        .vcc = r->vcc,
+        .flags = r->flags,
+        .humitemp = r->humitemp,
+    };
+
+    ESP_LOGI(TAG, "Senzor %u: zprava %u, vcc %u, flags 0x%02X, verze 0x%02X", r->sensor_id, r->msg_id, r->vcc,
+             r->flags, r->version);
+    tsdb_append(&sample);
+    rollout_report(r->sensor_id, r->version);
+}
+
+static void handle_alert(const sensormsg_alert_t *a) {
+    rf_alert_t *alert = &_alerts[a->sensor_id];
+
+    // msg_id roste i pres restart senzoru (msg_ctr_start v main.c) - starsi poplach je zachyceny a znovu
+    // odvysilany ramec, CTR bez MAC by ho jinak prijal
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool stale = alert->reported && (int16_t)(a->msg_id - alert->report_msg_id) <= 0;
+    if (!stale) {
+        alert->pending = true;
+        alert->msg_id = a->msg_id;
+        alert->time_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(_lock);
+
+    if (stale) {
+        metric_add(METRIC_RF_ALERTS_STALE, 1);
+        ESP_LOGW(TAG, "Senzor %u: poplach se starym msg_id %u zahozen", a->sensor_id, a->msg_id);
+        return;
+    }
+
+    metric_add(METRIC_RF_ALERTS, 1);
+    ESP_LOGW(TAG, "Senzor %u: pohyb%s%s (zprava %u)", a->sensor_id, a->flags & SENSORMSG_FLAG_PIR ? " PIR" : "",
+             a->flags & SENSORMSG_FLAG_RCWL ? " RCWL" : "", a->msg_id);
+}
+
+// hlaseni k predchozimu poplachu - zmerime predstih a posuneme hranici pro dalsi poplachy
+static void link_alert(uint8_t sensor_id, uint16_t msg_id) {
+    rf_alert_t *alert = &_alerts[sensor_id];
+    int64_t lead_us = -1;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (alert->pending && alert->msg_id == msg_id) {
+        alert->pending = false;
+        lead_us = esp_timer_get_time() - alert->time_us;
+    }
+    if (!alert->reported || (int16_t)(msg_id - alert->report_msg_id) > 0) {
+        alert->reported = true;
+        alert->report_msg_id = msg_id;
+    }
+    xSemaphoreGive(_lock);
+
+    if (lead_us >= 0) metric_observe(METRIC_RF_ALERT_LEAD_US, lead_us);
+}
+
+static void handle_telemetry(const sensormsg_telemetry_t *t) {
+    ESP_LOGI(TAG, "Senzor %u: telemetrie, zasobnik %u B, aktivni %u/%u/%u ms, probuzeni %u/%u/%u/%u",
+             t->sensor_id, t->stack_free, t->am2302_ms, t->rf_ms, t->ir_ms,
+             t->wake_wdt, t->wake_pir, t->wake_rcwl, t->wake_ir_noise);
+    metric_sensor_telemetry(t);
+}
+
+static void handle_beacon(const sensormsg_beacon_t *b) {
+    ESP_LOGI(TAG, "Senzor %u: bootloader pripraven%s", b->sensor_id, b->nrz ? ", umi NRZ" : "");
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _beacon_count++;
+    _beacon_sensor_id = b->sensor_id;
+    if (b->nrz) _beacon_nrz[b->sensor_id / 8] |= 1 << b->sensor_id % 8;
+    else _beacon_nrz[b->sensor_id / 8] &= ~(1 << b->sensor_id % 8);
+    _boot_beacons++;
+    if (!b->nrz) _boot_4b6b = true;
+    xSemaphoreGive(_lock);
+}
+
+irframe_code_t rf_beacon_line_code(uint8_t sensor_id) {
+    bool nrz = false;
+
+    if (!_lock) return IRFRAME_CODE_4B6B;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    nrz = _beacon_count && _beacon_nrz[sensor_id / 8] & 1 << sensor_id % 8;
+    xSemaphoreGive(_lock);
+    return nrz ? IRFRAME_CODE_NRZ : IRFRAME_CODE_4B6B;
+}
+
+void rf_boot_sent(void) {
+    if (!_lock) return;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _boot_beacons = 0;
+    _boot_4b6b = false;
+    xSemaphoreGive(_lock);
+}
+
+irframe_code_t rf_boot_line_code(void) {
+    bool nrz = false;
+
+    if (!_lock) return IRFRAME_CODE_4B6B;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    nrz = _boot_beacons && !_boot_4b6b;
+    xSemaphoreGive(_lock);
+    return nrz ? IRFRAME_CODE_NRZ : IRFRAME_CODE_4B6B;
+}
+
+uint32_t rf_beacon_count(void) {
+    uint32_t count = 0;
+
+    if (!_lock) return 0;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    count = _beacon_count;
+    xSemaphoreGive(_lock);
+    return count;
+}
+
+bool rf_wait_beacon(uint8_t sensor_id, uint32_t since, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    while (_lock) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool seen = _beacon_count != since && (sensor_id == RF_SENSOR_ANY || _beacon_sensor_id == sensor_id);
+        since = _beacon_count;
+        xSemaphoreGive(_lock);
+
+        if (seen) return true;
+        if (xTaskGetTickCount() - start >= timeout) return false;
+        vTaskDelay(pdMS_TO_TICKS(RF_BEACON_POLL_MS));
+    }
+
+    vTaskDelay(timeout);    // prijem neni spusten
+    return false;
+}
+
+static esp_err_t frame_from(int receiver, const uint8_t *frame, size_t len) {
+    uint8_t payload[SENSORMSG_MAX_LEN];
+    size_t payload_len;
+    sensormsg_t msg;
+
+    TRACE_HEX(TAG, frame, len);
+
+    const uint8_t *data = sensormsg_unframe(frame, len, &payload_len);
+    if (!data || payload_len > sizeof(payload)) {
+        fusion_error(receiver);
+        return ESP_ERR_INVALID_CRC;
+    }
+    memcpy(payload, data, payload_len);
+
+    if (sensormsg_decode(payload, payload_len, &msg) == SENSORMSG_INVALID) {
+        fusion_error(receiver);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    metric_add(METRIC_RF_FRAMES, 1);
+
+    // beacon jde jen jednou a nema msg_id
+    if (msg.type == SENSORMSG_BEACON) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        rffusion_count(&_fusion, receiver, now_ms());
+        xSemaphoreGive(_lock);
+        metric_sensor_frame(msg.beacon.sensor_id, true);
+        handle_beacon(&msg.beacon);
+        return ESP_OK;
+    }
+
+    uint8_t sensor_id, kind = RFFUSION_KIND_MESSAGE;
+    uint16_t msg_id;
+    switch (msg.type) {
+        case SENSORMSG_REPORT:
+            sensor_id = msg.report.sensor_id;
+            msg_id = msg.report.msg_id;
+            break;
+        case SENSORMSG_TELEMETRY:
+            sensor_id = msg.telemetry.sensor_id;
+            msg_id = msg.telemetry.msg_id;
+            break;
+        default:
+            // poplach sdili msg_id s naslednym hlasenim - vlastni druh klice
+            sensor_id = msg.alert.sensor_id;
+            msg_id = msg.alert.msg_id;
+            kind = RFFUSION_KIND_ALERT;
+            break;
+    }
+
+    metric_sensor_frame(sensor_id, true);
+
+    if (!fusion_accept(receiver, rffusion_key(sensor_id, msg_id, kind))) {
+        metric_add(METRIC_RF_DUPLICATES, 1);
+        return ESP_OK;
+    }
+
+    if (msg.type == SENSORMSG_REPORT) {
+        link_alert(sensor_id, msg_id);
+        handle_report(&msg.report);
+    } else if (msg.type == SENSORMSG_TELEMETRY) {
+        handle_telemetry(&msg.telemetry);
+    } else {
+        handle_alert(&msg.alert);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t rf_frame_received(const uint8_t *frame, size_t len) {
+    return frame_from(-1, frame, len);
+}
+
+size_t rf_receivers(rffusion_receiver_t *out, size_t max) {
+    size_t n = 0;
+
+    if (!_lock) return 0;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int i = 0; i < RFFUSION_RECEIVERS && n < max; i++) {
+        if (_fusion.receivers[i].used) out[n++] = _fusion.receivers[i];
+    }
+    xSemaphoreGive(_lock);
+    return n;
+}
+
+typedef struct {
+    int sock;
+    int receiver;               // index v _fusion
+    size_t len;
+    char line[RF_LINE_LEN];
+} rf_conn_t;
+
+static void conn_set_receiver(rf_conn_t *c, const char *name) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    c->receiver = rffusion_rename(&_fusion, c->receiver, name);
+    xSemaphoreGive(_lock);
+}
+
+static void conn_line(rf_conn_t *c, char *line) {
+    uint8_t frame[SENSORMSG_MAX_LEN + 2];
+
+    if (!line[0]) return;
+    // prijimac se muze predstavit - jinak ho zname podle IP
+    if (!strncmp(line, "RX ", 3)) {
+        conn_set_receiver(c, line + 3);
+        ESP_LOGI(TAG, "Prijimac %s", line + 3);
+        return;
+    }
+
+    int len = sensormsg_parse_hex(line, frame, sizeof(frame));
+    if (len < 0) {
+        ESP_LOGW(TAG, "Chybny radek: %s", line);
+        fusion_error(c->receiver);
+        return;
+    }
+    frame_from(c->receiver, frame, len);
+}
+
+// vraci -1 po uzavreni spojeni
+static int conn_read(rf_conn_t *c) {
+    int n = recv(c->sock, c->line + c->len, sizeof(c->line) - 1 - c->len, 0);
+    if (n <= 0) return -1;
+    c->len += n;
+
+    char *start = c->line, *end;
+    while ((end = memchr(start, '\n', c->line + c->len - start))) {
+        *end = 0;
+        if (end > start && end[-1] == '\r') end[-1] = 0;
+        conn_line(c, start);
+        start = end + 1;
+    }
+    c->len -= start - c->line;
+    memmove(c->line, start, c->len);
+
+    if (c->len == sizeof(c->line) - 1) {
+        c->len = 0;         // radek bez konce - zahodime
+        fusion_error(c->receiver);
+    }
+    return 0;
+}
+
+static void conn_close(rf_conn_t *c) {
+    ESP_LOGI(TAG, "Prijimac odpojen");
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    rffusion_disconnect(&_fusion, c->receiver);
+    xSemaphoreGive(_lock);
+    close(c->sock);
+    c->sock = -1;
+}
+
+// prijimace drzi spojeni otevrena a posilaji radek za radkem - vsechny obsluhuje jeden task pres select()
+static void rf_server_task(void *arg) {
+    static rf_conn_t conns[RF_MAX_RECEIVERS];
+    for (int i = 0; i < RF_MAX_RECEIVERS; i++) conns[i].sock = -1;
+
+    wait_wifi_connected(portMAX_DELAY);
+    int server_fd = socket_listen(_port, RF_MAX_RECEIVERS);
+    if (server_fd < 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        fd_set fds;
+        int max_fd = server_fd;
+
+        FD_ZERO(&fds);
+        FD_SET(server_fd, &fds);
+        for (int i = 0; i < RF_MAX_RECEIVERS; i++) {
+            if (conns[i].sock < 0) continue;
+            FD_SET(conns[i].sock, &fds);
+            if (conns[i].sock > max_fd) max_fd = conns[i].sock;
+        }
+
+        if (select(max_fd + 1, &fds, NULL, NULL, NULL) < 0) {
+            ESP_LOGE(TAG, "select selhal: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        for (int i = 0; i < RF_MAX_RECEIVERS; i++) {
+            if (conns[i].sock >= 0 && FD_ISSET(conns[i].sock, &fds) && conn_read(&conns[i])) conn_close(&conns[i]);
+        }
+
+        if (FD_ISSET(server_fd, &fds)) {
+            struct sockaddr_in addr;
+            socklen_t addr_len = sizeof(addr);
+            int sock = accept(server_fd, (struct sockaddr *)&addr, &addr_len);
+            if (sock < 0) continue;
+
+            rf_conn_t *c = NULL;
+            for (int i = 0; i < RF_MAX_RECEIVERS && !c; i++) {
+                if (conns[i].sock < 0) c = &conns[i];
+            }
+            if (!c) {
+                ESP_LOGW(TAG, "Prilis mnoho prijimacu");
+                close(sock);
+                continue;
+            }
+
+            c->sock = sock;
+            c->len = 0;
+            c->receiver = -1;
+            conn_set_receiver(c, inet_ntoa(addr.sin_addr));
+            ESP_LOGI(TAG, "Prijimac %s pripojen", inet_ntoa(addr.sin_addr));
+        }
+    }
+}
+
+void rf_socket_server_init(int socket_port) {
+    _lock = xSemaphoreCreateMutex();
+    rffusion_init(&_fusion, RFFUSION_WINDOW_MS);
+    _port = socket_port;
+
+    xTaskCreate(rf_server_task, "rf_socket_server", 4096, NULL, 4, NULL);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Prijem zprav ze senzoru (433 MHz). Brana zatim nema vlastni RF prijimac - demodulovane ramce RH_ASK
+// posilaji externi prijimace (uzly ESP32 po budove, pro testy sim/rfhub) na port rf_socket_server_init
+// jako radky hex znaku:
+//   "RX <jmeno>\n"            volitelne - jmeno prijimace pro statistiku, jinak jeho IP
+//   "<delka><data><crc>\n"   napr. vystup RadioHead prijimace s hlavickou a CRC
+// Az RF_MAX_RECEIVERS spojeni soucasne, kopie stejne zpravy z vice prijimacu slouci rffusion.c.
+// Statistika prijimacu je v metrikach (rf_receiver_*).
+// Platna hlaseni jdou do tsdb a rollout_report, telemetrie do metrik (sensor_*), poplach pri pohybu
+// se zaloguje a s hlasenim se stejnym msg_id se sparuje (rf_alert_lead_us) - poplach s msg_id, ktere
+// uz prislo v hlaseni, se zahodi (rf_alerts_stale_total), beacon bootloaderu
+// probudi rf_wait_beacon a urci kodovani stranek (rf_beacon_line_code).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "rffusion.h"
+#include "sensormsg.h"
+#include "irframe.h"
+
+#define RF_SENSOR_ANY 0xFF      // beacon od libovolneho senzoru - po "B 255" vsem
+#define RF_BEACON_POLL_MS 10
+#define RF_MAX_RECEIVERS 8      // soucasna spojeni - kazde je soket lwip (CONFIG_LWIP_MAX_SOCKETS)
+#define RF_LINE_LEN (2 * (SENSORMSG_MAX_LEN + 2) + 32)
+
+// zpracuje jeden demodulovany ramec (vcetne delky a CRC) - volat z libovolneho prijimace
+esp_err_t rf_frame_received(const uint8_t *frame, size_t len);
+
+// kopie statistiky prijimacu, vraci jejich pocet
+size_t rf_receivers(rffusion_receiver_t *out, size_t max);
+
+// pocet prijatych beaconu - precist pred prikazem do bootloaderu a predat rf_wait_beacon
+uint32_t rf_beacon_count(void);
+// ceka na beacon senzoru prijaty po 'since', false po timeoutu (i bez pripojeneho prijimace)
+bool rf_wait_beacon(uint8_t sensor_id, uint32_t since, TickType_t timeout);
+// kodovani stranek pro bootloader senzoru podle jeho posledniho beaconu ('N' - NRZ),
+// bez beaconu 4b6b, ktery umi kazdy bootloader - volat az po rf_wait_beacon
+irframe_code_t rf_beacon_line_code(uint8_t sensor_id);
+// kazdy prikaz do bootloaderu pres IR NEC ("B <id>" i z rollout, "BOOT") - zacne znovu sbirat beacony pro
+// rf_boot_line_code
+void rf_boot_sent(void);
+// kodovani HEX na portu irtx: NRZ jen kdyz po poslednim rf_boot_sent prisel beacon a vsechny byly 'N' -
+// po "BOOT" muze v bootloaderu cekat vic senzoru a 4b6b umi kazdy
+irframe_code_t rf_boot_line_code(void);
+
+void rf_socket_server_init(int socket_port);
@@ -0,0 +1,79 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "sockhelper.h"
+#include "tsdb.h"
+#include "soctsdb.h"
+
+#define TAG "SOCTSDB"
+
+typedef struct {
+    int sock;
+    size_t len;
+    char buf[1024];
+} query_out_t;
+
+static int out_flush(query_out_t *out) {
+    size_t sent = 0;
+    while (sent < out->len) {
+        int n = send(out->sock, out->buf + sent, out->len - sent, 0);
+        if (n <= 0) return 1;
+        sent += n;
+    }
+    out->len = 0;
+    return 0;
+}
+
+static int send_sample(const tsdb_sample_t *s, void *ctx) {
+    query_out_t *out = ctx;
+    if (sizeof(out->buf) - out->len < 64 && out_flush(out)) return 1;
+    out->len += snprintf(out->buf + out->len, sizeof(out->buf) - out->len,
+                         "%" PRIu32 ",%u,%" PRIu32 ",%u,0x%02X,0x%08" PRIX32 "\n",
+                         s->time, s->msg_id, s->tick, s->vcc, s->flags, s->humitemp);
+    return 0;
+}
+
+static int do_query(int sock) {
+    char line[64];
+
+    if (socket_read_line(sock, line, sizeof(line)) < 0) return -1;
+
+    int sensor_id;
+    long long from, to = 0;
+    int args = sscanf(line, "%d %lld %lld", &sensor_id, &from, &to);
+    if (args < 2 || sensor_id < 0 || sensor_id > 255) {
+        ESP_LOGE(TAG, "Chybny dotaz: %s", line);
+        return -1;
+    }
+
+    uint32_t now = time(NULL);
+    if (from < 0) from += now;
+    if (args < 3) to = now;
+
+    static query_out_t out;
+    out.sock = sock;
+    out.len = 0;
+
+    tsdb_query(sensor_id, from, to, send_sample, &out);
+    out_flush(&out);
+    return 0;
+}
+
+void tsdb_socket_server_init(int socket_port) {
+    socket_server_params *params = malloc(sizeof(socket_server_params));
+    params->port = socket_port;
+    params->handler = do_query;
+    params->redirect_stdout = false;
+    params->redirect_stdin = false;
+    params->upload_ready = false;
+
+    xTaskCreate(socket_server, "tsdb_socket_server", 4096, params, 4, NULL);
+}
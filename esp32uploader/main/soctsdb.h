@@ -0,0 +1,5 @@
+#pragma once
+
+// Dotaz: "<sensor_id> <od> [do]\n" - unix cas v s, zaporne <od> je relativne k ted (-86400 = 24 h).
+// Odpoved: CSV radky time,msg_id,tick,vcc,flags,humitemp a konec spojeni.
+void tsdb_socket_server_init(int socket_port);
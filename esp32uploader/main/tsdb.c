@@ -0,0 +1,471 @@
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "tsdb.h"
+#include "metrics.h"
+
+#define TAG "TSDB"
+
+#define SECTOR_SIZE     4096
+#define SECTOR_MAGIC    0x42445354  // "TSDB"
+#define CHUNK_MAGIC     0xC5
+#define MAX_SECTORS     256
+#define MAX_CHUNK_LEN   (TSDB_CHUNK_SAMPLES * 24)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;           // roste s kazdym novym sektorem - nejvyssi je aktualni
+    uint32_t erase_count;   // kolikrat byl sektor smazan
+    uint32_t reserved;
+} sector_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;          // 0xFF - dal v sektoru nic neni
+    uint8_t sensor_id;
+    uint8_t count;
+    uint8_t crc;            // CRC8 dat bloku
+    uint16_t len;
+    uint16_t reserved;
+    uint32_t t_first;
+    uint32_t t_last;
+} chunk_hdr_t;
+
+typedef struct {
+    uint32_t seq;           // 0 - prazdny nebo neplatny sektor
+    uint32_t t_min, t_max;
+    uint32_t sensors[8];    // bitmapa senzoru, ktere maji v sektoru data
+} sector_info_t;
+
+typedef struct {
+    uint8_t count;
+    tsdb_sample_t samples[TSDB_CHUNK_SAMPLES];
+} open_chunk_t;
+
+// rozpracovany dotaz - mezi bloky se nedrzi _lock
+typedef struct {
+    uint8_t sensor_id;
+    uint32_t from, to;
+    uint32_t max_seq;       // sektory zalozene az behem dotazu se preskoci
+    size_t sector;
+    uint32_t seq;           // 0 - sektor se jeste necetl
+    size_t off;
+    uint8_t buf[MAX_CHUNK_LEN];
+    tsdb_sample_t samples[TSDB_CHUNK_SAMPLES];
+} query_t;
+
+static const esp_partition_t *_part;
+static SemaphoreHandle_t _lock;
+static SemaphoreHandle_t _query_lock;   // dotazy jdou za sebou - sdili _query
+static query_t _query;
+static sector_info_t *_sectors;
+static size_t _sector_count;
+static size_t _cur_sector;
+static size_t _cur_offset;
+static uint32_t _max_seq;
+static uint32_t _max_erases;    // nejopotrebovanejsi sektor - metrika tsdb_max_erases
+static open_chunk_t _open[TSDB_OPEN_SENSORS];
+
+// ----------------------------- kodovani -----------------------------
+
+static uint8_t crc8(const uint8_t *buf, size_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+    return crc;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *p, size_t len, uint32_t *v) {
+    uint32_t res = 0;
+    for (size_t n = 0; n < len && n < 5; n++) {
+        res |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            *v = res;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+// sloupce: cas, msg_id, tick, vcc, flags, vlhkost, teplota - vse jako rozdil proti predchozimu vzorku
+static size_t encode_chunk(const open_chunk_t *oc, uint8_t *out) {
+    const tsdb_sample_t *s = oc->samples;
+    size_t n = 0;
+    uint8_t i;
+
+    for (i = 0; i < oc->count; i++)
+        n += put_varint(out + n, zigzag(i ? (int32_t)(s[i].time - s[i - 1].time) : 0));
+    for (i = 0; i < oc->count; i++)
+        n += put_varint(out + n, zigzag(i ? (int16_t)(s[i].msg_id - s[i - 1].msg_id) : (int32_t)s[i].msg_id));
+    for (i = 0; i < oc->count; i++)
+        n += put_varint(out + n, zigzag(i ? (int32_t)(s[i].tick - s[i - 1].tick) : (int32_t)s[i].tick));
+    for (i = 0; i < oc->count; i++)
+        n += put_varint(out + n, zigzag(i ? (int16_t)(s[i].vcc - s[i - 1].vcc) : (int32_t)s[i].vcc));
+    for (i = 0; i < oc->count; i++)
+        out[n++] = s[i].flags;
+    for (i = 0; i < oc->count; i++)
+        n += put_varint(out + n, zigzag(i ? (int16_t)((s[i].humitemp >> 16) - (s[i - 1].humitemp >> 16))
+                                          : (int32_t)(s[i].humitemp >> 16)));
+    for (i = 0; i < oc->count; i++)
+        n += put_varint(out + n, zigzag(i ? (int16_t)((s[i].humitemp & 0xFFFF) - (s[i - 1].humitemp & 0xFFFF))
+                                          : (int32_t)(s[i].humitemp & 0xFFFF)));
+    return n;
+}
+
+// dekoduje jeden sloupec, 'apply' zapise hodnotu do vzorku
+#define DECODE_COLUMN(expr)                                         \
+    for (i = 0; i < hdr->count; i++) {                              \
+        uint32_t raw;                                               \
+        size_t used = get_varint(data + n, len - n, &raw);          \
+        if (!used) return ESP_ERR_INVALID_SIZE;                     \
+        n += used;                                                  \
+        int32_t d = unzigzag(raw);                                  \
+        expr;                                                       \
+    }
+
+static esp_err_t decode_chunk(const chunk_hdr_t *hdr, const uint8_t *data, size_t len, tsdb_sample_t *s) {
+    size_t n = 0;
+    uint8_t i;
+
+    DECODE_COLUMN(s[i].time = i ? s[i - 1].time + d : hdr->t_first);
+    DECODE_COLUMN(s[i].msg_id = i ? s[i - 1].msg_id + d : d);
+    DECODE_COLUMN(s[i].tick = i ? s[i - 1].tick + d : (uint32_t)d);
+    DECODE_COLUMN(s[i].vcc = i ? s[i - 1].vcc + d : d);
+    if (n + hdr->count > len) return ESP_ERR_INVALID_SIZE;
+    for (i = 0; i < hdr->count; i++) s[i].flags = data[n++];
+    DECODE_COLUMN(s[i].humitemp = (uint32_t)(uint16_t)(i ? (s[i - 1].humitemp >> 16) + d : d) << 16);
+    DECODE_COLUMN(s[i].humitemp |= (uint16_t)(i ? (s[i - 1].humitemp & 0xFFFF) + d : d));
+
+    for (i = 0; i < hdr->count; i++) s[i].sensor_id = hdr->sensor_id;
+    return n == len ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+// ----------------------------- sektory -----------------------------
+
+static void sector_note_chunk(sector_info_t *si, const chunk_hdr_t *hdr) {
+    uint32_t t0 = hdr->t_first < hdr->t_last ? hdr->t_first : hdr->t_last;
+    uint32_t t1 = hdr->t_first < hdr->t_last ? hdr->t_last : hdr->t_first;
+    if (!si->t_min || t0 < si->t_min) si->t_min = t0;
+    if (t1 > si->t_max) si->t_max = t1;
+    si->sensors[hdr->sensor_id >> 5] |= 1UL << (hdr->sensor_id & 31);
+}
+
+// projde bloky sektoru a vrati offset prvniho volneho mista
+static size_t sector_scan(size_t sector, sector_info_t *si) {
+    size_t off = sizeof(sector_hdr_t);
+    chunk_hdr_t hdr;
+
+    while (off + sizeof(hdr) <= SECTOR_SIZE) {
+        if (esp_partition_read(_part, sector * SECTOR_SIZE + off, &hdr, sizeof(hdr)) != ESP_OK) break;
+        if (hdr.magic != CHUNK_MAGIC || off + sizeof(hdr) + hdr.len > SECTOR_SIZE) break;
+        if (si) sector_note_chunk(si, &hdr);
+        off += sizeof(hdr) + hdr.len;
+    }
+    return off;
+}
+
+static int sector_is_erased_from(size_t sector, size_t off) {
+    uint32_t buf[32];
+    while (off < SECTOR_SIZE) {
+        size_t n = SECTOR_SIZE - off < sizeof(buf) ? SECTOR_SIZE - off : sizeof(buf);
+        if (esp_partition_read(_part, sector * SECTOR_SIZE + off, buf, n) != ESP_OK) return 0;
+        for (size_t i = 0; i < n; i++) {
+            if (((uint8_t *)buf)[i] != 0xFF) return 0;
+        }
+        off += n;
+    }
+    return 1;
+}
+
+static esp_err_t start_sector(size_t sector) {
+    sector_hdr_t hdr;
+    uint32_t erase_count = 0;
+
+    if (esp_partition_read(_part, sector * SECTOR_SIZE, &hdr, sizeof(hdr)) == ESP_OK && hdr.magic == SECTOR_MAGIC) {
+        erase_count = hdr.erase_count;
+    }
+
+    esp_err_t err = esp_partition_erase_range(_part, sector * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK) return err;
+
+    hdr = (sector_hdr_t) {
+        .magic = SECTOR_MAGIC,
+        .seq = ++_max_seq,
+        .erase_count = erase_count + 1,
+        .reserved = 0xFFFFFFFF,
+    };
+    err = esp_partition_write(_part, sector * SECTOR_SIZE, &hdr, sizeof(hdr));
+    if (err != ESP_OK) return err;
+
+    if (hdr.erase_count > _max_erases) {
+        _max_erases = hdr.erase_count;
+        metric_gauge(METRIC_TSDB_MAX_ERASES, _max_erases);
+    }
+
+    memset(&_sectors[sector], 0, sizeof(sector_info_t));
+    _sectors[sector].seq = hdr.seq;
+    _cur_sector = sector;
+    _cur_offset = sizeof(hdr);
+    return ESP_OK;
+}
+
+static esp_err_t write_chunk(const open_chunk_t *oc) {
+    static uint8_t buf[sizeof(chunk_hdr_t) + MAX_CHUNK_LEN];
+    chunk_hdr_t *hdr = (chunk_hdr_t *)buf;
+    size_t len = encode_chunk(oc, buf + sizeof(chunk_hdr_t));
+
+    *hdr = (chunk_hdr_t) {
+        .magic = CHUNK_MAGIC,
+        .sensor_id = oc->samples[0].sensor_id,
+        .count = oc->count,
+        .crc = crc8(buf + sizeof(chunk_hdr_t), len),
+        .len = len,
+        .reserved = 0xFFFF,
+        .t_first = oc->samples[0].time,
+        .t_last = oc->samples[oc->count - 1].time,
+    };
+
+    if (_cur_offset + sizeof(chunk_hdr_t) + len > SECTOR_SIZE) {
+        esp_err_t err = start_sector((_cur_sector + 1) % _sector_count);
+        if (err != ESP_OK) return err;
+    }
+
+    esp_err_t err = esp_partition_write(_part, _cur_sector * SECTOR_SIZE + _cur_offset, buf, sizeof(chunk_hdr_t) + len);
+    if (err != ESP_OK) return err;
+
+    sector_note_chunk(&_sectors[_cur_sector], hdr);
+    _cur_offset += sizeof(chunk_hdr_t) + len;
+    return ESP_OK;
+}
+
+static esp_err_t flush_open(open_chunk_t *oc) {
+    if (!oc->count) return ESP_OK;
+    esp_err_t err = write_chunk(oc);
+    metric_add(err == ESP_OK ? METRIC_TSDB_CHUNKS : METRIC_TSDB_ERRORS, 1);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Zapis bloku selhal: %s", esp_err_to_name(err));
+    }
+    oc->count = 0;
+    return err;
+}
+
+static void flush_stale(uint32_t now) {
+    for (int i = 0; i < TSDB_OPEN_SENSORS; i++) {
+        open_chunk_t *oc = &_open[i];
+        if (oc->count && now - oc->samples[0].time >= TSDB_FLUSH_S) flush_open(oc);
+    }
+}
+
+static void tsdb_task(void *pvParameter) {
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(60000));
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        flush_stale(time(NULL));
+        xSemaphoreGive(_lock);
+    }
+}
+
+esp_err_t tsdb_init(void) {
+    _part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, TSDB_PARTITION_LABEL);
+    if (!_part) {
+        ESP_LOGE(TAG, "Oddil %s nenalezen", TSDB_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    _sector_count = _part->size / SECTOR_SIZE;
+    if (_sector_count > MAX_SECTORS) _sector_count = MAX_SECTORS;
+    _sectors = calloc(_sector_count, sizeof(sector_info_t));
+    _lock = xSemaphoreCreateMutex();
+    _query_lock = xSemaphoreCreateMutex();
+    if (!_sectors || !_lock || !_query_lock) return ESP_ERR_NO_MEM;
+
+    // najdeme posledni zapisovany sektor a sestavime index
+    int64_t last = -1;
+    for (size_t i = 0; i < _sector_count; i++) {
+        sector_hdr_t hdr;
+        if (esp_partition_read(_part, i * SECTOR_SIZE, &hdr, sizeof(hdr)) != ESP_OK || hdr.magic != SECTOR_MAGIC) continue;
+        _sectors[i].seq = hdr.seq;
+        if (hdr.erase_count > _max_erases) _max_erases = hdr.erase_count;
+        sector_scan(i, &_sectors[i]);
+        if (hdr.seq > _max_seq) {
+            _max_seq = hdr.seq;
+            last = i;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    if (last < 0) {
+        err = start_sector(0);
+    } else {
+        _cur_sector = last;
+        _cur_offset = sector_scan(last, NULL);
+        // nedokonceny zapis pred vypadkem napajeni - do zbytku sektoru uz nepiseme
+        if (!sector_is_erased_from(last, _cur_offset)) err = start_sector((last + 1) % _sector_count);
+    }
+
+    metric_gauge(METRIC_TSDB_MAX_ERASES, _max_erases);
+    ESP_LOGI(TAG, "%u sektoru, aktualni %u, offset %u, seq %" PRIu32 ", nejvic smazani %" PRIu32,
+             (unsigned)_sector_count, (unsigned)_cur_sector, (unsigned)_cur_offset, _max_seq, _max_erases);
+
+    if (err == ESP_OK) xTaskCreate(tsdb_task, "tsdb", 3072, NULL, 3, NULL);
+    return err;
+}
+
+esp_err_t tsdb_append(const tsdb_sample_t *sample) {
+    esp_err_t err = ESP_OK;
+    open_chunk_t *oc = NULL, *oldest = &_open[0];
+
+    if (!_part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+
+    for (int i = 0; i < TSDB_OPEN_SENSORS; i++) {
+        open_chunk_t *c = &_open[i];
+        if (c->count && c->samples[0].sensor_id == sample->sensor_id) {
+            oc = c;
+            break;
+        }
+        if (!c->count && !oc) oc = c;
+        if (c->count && oldest->count && c->samples[0].time < oldest->samples[0].time) oldest = c;
+    }
+
+    if (!oc) {
+        // vsechny buffery obsazene - uvolnime nejstarsi
+        err = flush_open(oldest);
+        oc = oldest;
+    }
+
+    oc->samples[oc->count++] = *sample;
+    metric_add(METRIC_TSDB_SAMPLES, 1);
+    if (oc->count == TSDB_CHUNK_SAMPLES) err = flush_open(oc);
+
+    flush_stale(sample->time);
+
+    xSemaphoreGive(_lock);
+    return err;
+}
+
+esp_err_t tsdb_flush(void) {
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int i = 0; i < TSDB_OPEN_SENSORS; i++) {
+        esp_err_t e = flush_open(&_open[i]);
+        if (e != ESP_OK) err = e;
+    }
+    xSemaphoreGive(_lock);
+    return err;
+}
+
+static int emit_range(const tsdb_sample_t *s, int count, uint32_t from, uint32_t to, tsdb_query_cb cb, void *ctx) {
+    for (int i = 0; i < count; i++) {
+        if (s[i].time >= from && s[i].time <= to && cb(&s[i], ctx)) return 1;
+    }
+    return 0;
+}
+
+// dalsi blok v q->sector pod _lock - vraci pocet vzorku v q->samples (0 - blok jineho senzoru, mimo
+// rozsah nebo poskozeny), -1 na konci sektoru
+static int query_chunk(query_t *q) {
+    sector_info_t *si = &_sectors[q->sector];
+    chunk_hdr_t hdr;
+
+    if (!q->seq) {
+        if (!si->seq || si->seq > q->max_seq) return -1;
+        if (!(si->sensors[q->sensor_id >> 5] & (1UL << (q->sensor_id & 31)))) return -1;
+        if (si->t_max < q->from || si->t_min > q->to) return -1;
+        q->seq = si->seq;
+        q->off = sizeof(sector_hdr_t);
+    }
+    // sektor byl mezitim smazan a zapisuje se znovu
+    if (si->seq != q->seq) return -1;
+
+    size_t end = q->sector == _cur_sector ? _cur_offset : SECTOR_SIZE;
+    size_t base = q->sector * SECTOR_SIZE;
+    if (q->off + sizeof(hdr) > end) return -1;
+    if (esp_partition_read(_part, base + q->off, &hdr, sizeof(hdr)) != ESP_OK) return -1;
+    if (hdr.magic != CHUNK_MAGIC || hdr.len > MAX_CHUNK_LEN) return -1;
+
+    size_t data = q->off + sizeof(hdr);
+    q->off = data + hdr.len;
+
+    uint32_t t0 = hdr.t_first < hdr.t_last ? hdr.t_first : hdr.t_last;
+    uint32_t t1 = hdr.t_first < hdr.t_last ? hdr.t_last : hdr.t_first;
+    if (hdr.sensor_id != q->sensor_id || t1 < q->from || t0 > q->to) return 0;
+    if (esp_partition_read(_part, base + data, q->buf, hdr.len) != ESP_OK || crc8(q->buf, hdr.len) != hdr.crc ||
+        decode_chunk(&hdr, q->buf, hdr.len, q->samples) != ESP_OK) return 0;
+    return hdr.count;
+}
+
+// _lock se drzi jen pri cteni a dekodovani jednoho bloku - cb posila do soketu (soctsdb.c) a pomaly
+// klient nesmi blokovat tsdb_append a s nim prijem RF
+esp_err_t tsdb_query(uint8_t sensor_id, uint32_t from, uint32_t to, tsdb_query_cb cb, void *ctx) {
+    query_t *q = &_query;
+    int stop = 0, count;
+
+    if (!_part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(_query_lock, portMAX_DELAY);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    size_t cur = _cur_sector;
+    q->sensor_id = sensor_id;
+    q->from = from;
+    q->to = to;
+    q->max_seq = _max_seq;
+    xSemaphoreGive(_lock);
+
+    // nejstarsi sektor je hned za aktualnim
+    for (size_t k = 1; k <= _sector_count && !stop; k++) {
+        q->sector = (cur + k) % _sector_count;
+        q->seq = 0;
+        while (!stop) {
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            count = query_chunk(q);
+            xSemaphoreGive(_lock);
+            if (count < 0) break;
+            stop = emit_range(q->samples, count, from, to, cb, ctx);
+        }
+    }
+
+    // nakonec data, ktera jsou zatim jen v RAM - kazdy senzor ma nejvyse jeden rozepsany blok
+    count = 0;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int i = 0; i < TSDB_OPEN_SENSORS; i++) {
+        open_chunk_t *oc = &_open[i];
+        if (oc->count && oc->samples[0].sensor_id == sensor_id) {
+            count = oc->count;
+            memcpy(q->samples, oc->samples, count * sizeof(tsdb_sample_t));
+            break;
+        }
+    }
+    xSemaphoreGive(_lock);
+    if (!stop) emit_range(q->samples, count, from, to, cb, ctx);
+
+    xSemaphoreGive(_query_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// Casova rada dekodovanych zprav ze senzoru v oddilu "tsdb" (partitions.csv).
+//
+// Oddil je kruhovy buffer sektoru (4 KB). Zpravy se sbiraji v RAM po senzorech a po TSDB_CHUNK_SAMPLES
+// (nebo po TSDB_FLUSH_S sekundach) se zapisou jako jeden blok - sloupce cas, msg_id, tick, vcc,
+// flags, vlhkost a teplota kodovane jako zigzag delta + varint. Sektory se prepisuji postupne dokola,
+// takze se flash opotrebovava rovnomerne - pocet smazani nese hlavicka sektoru, nejvyssi je metrika
+// tsdb_max_erases. Pri startu se z hlavicek bloku sestavi index v RAM
+// (rozsah casu a seznam senzoru v kazdem sektoru) - dotaz cte jen bloky, ktere muze potrebovat.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define TSDB_PARTITION_LABEL "tsdb"
+#define TSDB_CHUNK_SAMPLES   32
+#define TSDB_FLUSH_S         900    // nejdele tak dlouho jsou data jen v RAM
+#define TSDB_OPEN_SENSORS    16     // pocet senzoru s rozepsanym blokem
+
+typedef struct {
+    uint32_t time;          // cas brany (s, unix pokud bezi SNTP)
+    uint8_t sensor_id;
+    uint16_t msg_id;
+    uint32_t tick;
+    uint16_t vcc;
+    uint8_t flags;
+    uint32_t humitemp;
+} tsdb_sample_t;
+
+// vraci 0 pro pokracovani, jinak dotaz ukonci
+typedef int (*tsdb_query_cb)(const tsdb_sample_t *sample, void *ctx);
+
+esp_err_t tsdb_init(void);
+esp_err_t tsdb_append(const tsdb_sample_t *sample);
+esp_err_t tsdb_flush(void);
+// projde vzorky senzoru v rozsahu <from, to> serazene podle zapisu; cb se vola bez zamku, zapis bezi dal -
+// vzorky ulozene az behem dotazu se vratit nemusi
+esp_err_t tsdb_query(uint8_t sensor_id, uint32_t from, uint32_t to, tsdb_query_cb cb, void *ctx);
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "util.h"
 
@@ -16,3 +18,17 @@ void log_hex(uint8_t *data, size_t len) {
 
     ESP_LOGI("LOG_HEX", "Data: %s", buf);
 }
+
+static SemaphoreHandle_t _ir_tx_lock;
+
+void ir_tx_lock_init(void) {
+    _ir_tx_lock = xSemaphoreCreateMutex();
+}
+
+void ir_tx_lock(void) {
+    xSemaphoreTake(_ir_tx_lock, portMAX_DELAY);
+}
+
+void ir_tx_unlock(void) {
+    xSemaphoreGive(_ir_tx_lock);
+}
@@ -1,3 +1,11 @@
 #pragma once
 
-void log_hex(uint8_t *data, size_t len);
\ No newline at end of file
+#include <stdint.h>
+#include <stddef.h>
+
+void log_hex(uint8_t *data, size_t len);
+
+// IR vysilac je jeden - socirtx, socirnec a rollout se musi stridat
+void ir_tx_lock_init(void);
+void ir_tx_lock(void);
+void ir_tx_unlock(void);
\ No newline at end of file
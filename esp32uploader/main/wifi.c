@@ -1,34 +1,139 @@
 #include <string.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "metrics.h"
 #include "wifi.h"
 
 #define TAG "WIFI"
 
+// Rychly start: posledni AP (BSSID + kanal) je v NVS, pripojeni pak nemusi skenovat vsechny kanaly.
+// connect_wifi() neblokuje - sluzby cekaji ve wait_wifi_connected() a sokety otevrou az s IP.
+// Pri vypadku se pripojujeme znovu s rostouci prodlevou (WIFI_BACKOFF_MIN_MS .. WIFI_BACKOFF_MAX_MS).
+
+#define NVS_NAMESPACE "wifi"
+#define NVS_KEY_AP    "ap"
+
+#define WIFI_BACKOFF_MIN_MS 100
+#define WIFI_BACKOFF_MAX_MS 30000
+
 static EventGroupHandle_t wifi_event_group;
 #define WIFI_CONNECTED_BIT BIT0
 
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_cached_ap_t;
+
+static esp_netif_t *_netif;
+static wifi_config_t _wifi_config;
+static esp_timer_handle_t _reconnect_timer;
+static uint32_t _backoff_ms;
+static bool _using_cache;
+
+static void load_cached_ap(wifi_config_t *config) {
+    nvs_handle_t nvs;
+    wifi_cached_ap_t ap;
+    size_t len = sizeof(ap);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return;
+    if (nvs_get_blob(nvs, NVS_KEY_AP, &ap, &len) == ESP_OK && len == sizeof(ap) && ap.channel) {
+        memcpy(config->sta.bssid, ap.bssid, sizeof(ap.bssid));
+        config->sta.bssid_set = true;
+        config->sta.channel = ap.channel;
+        _using_cache = true;
+        ESP_LOGI(TAG, "Posledni AP %02x:%02x:%02x:%02x:%02x:%02x, kanal %d",
+                 ap.bssid[0], ap.bssid[1], ap.bssid[2], ap.bssid[3], ap.bssid[4], ap.bssid[5], ap.channel);
+    }
+    nvs_close(nvs);
+}
+
+static void save_cached_ap(void) {
+    wifi_ap_record_t info;
+    wifi_cached_ap_t ap;
+
+    if (esp_wifi_sta_get_ap_info(&info) != ESP_OK) return;
+    if (_using_cache && !memcmp(_wifi_config.sta.bssid, info.bssid, 6) && _wifi_config.sta.channel == info.primary) return;
+
+    memcpy(ap.bssid, info.bssid, sizeof(ap.bssid));
+    ap.channel = info.primary;
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+    if (nvs_set_blob(nvs, NVS_KEY_AP, &ap, sizeof(ap)) == ESP_OK) nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void apply_static_ip(void) {
+    if (!WIFI_STATIC_IP[0]) return;
+
+    esp_netif_ip_info_t ip_info = {
+        .ip.addr = esp_ip4addr_aton(WIFI_STATIC_IP),
+        .netmask.addr = esp_ip4addr_aton(WIFI_STATIC_NETMASK),
+        .gw.addr = esp_ip4addr_aton(WIFI_STATIC_GW),
+    };
+    esp_netif_dhcpc_stop(_netif);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(_netif, &ip_info));
+    ESP_LOGI(TAG, "Staticka IP %s", WIFI_STATIC_IP);
+}
+
+static void reconnect_timer_cb(void *arg) {
+    esp_wifi_connect();
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
-    ESP_LOGI(TAG, "event base: %i, event_id: %i", event_base, event_id);
+    ESP_LOGD(TAG, "event base: %s, event_id: %i", event_base, (int)event_id);
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     }
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        esp_wifi_connect();
+        wifi_event_sta_disconnected_t *event = event_data;
+        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        metric_add(METRIC_WIFI_DISCONNECTS, 1);
+
+        if (_using_cache) {
+            // AP se mohl presunout na jiny kanal - dalsi pokus uz se vsemi kanaly
+            ESP_LOGW(TAG, "Pripojeni na posledni AP selhalo (%d), skenuji", event->reason);
+            _using_cache = false;
+            _wifi_config.sta.bssid_set = false;
+            _wifi_config.sta.channel = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &_wifi_config);
+        }
+
+        ESP_LOGI(TAG, "Odpojeno (%d), dalsi pokus za %" PRIu32 " ms", event->reason, _backoff_ms);
+        esp_timer_start_once(_reconnect_timer, _backoff_ms * 1000ULL);
+        _backoff_ms = _backoff_ms * 2 > WIFI_BACKOFF_MAX_MS ? WIFI_BACKOFF_MAX_MS : _backoff_ms * 2;
     }
     if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        _backoff_ms = WIFI_BACKOFF_MIN_MS;
+        metric_gauge(METRIC_BOOT_TO_IP_MS, esp_timer_get_time() / 1000);
+        ESP_LOGI(TAG, "Connected, %" PRId64 " ms od startu", esp_timer_get_time() / 1000);
+        save_cached_ap();
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
+
 bool is_wifi_connected() {
     esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
     if (netif == NULL) return false;
     return esp_netif_is_netif_up(netif);
 }
 
+bool wait_wifi_connected(TickType_t timeout) {
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
+                                           WIFI_CONNECTED_BIT,
+                                           pdFALSE,
+                                           pdTRUE,
+                                           timeout);
+    return bits & WIFI_CONNECTED_BIT;
+}
+
 void disconnect_wifi() {
     if (!is_wifi_connected()) return;
 
@@ -41,53 +146,45 @@ void disconnect_wifi() {
 }
 
 void init_wifi_radio() {
-    esp_log_level_set("init wifi radio", ESP_LOG_DEBUG);
-    esp_netif_create_default_wifi_sta();
+    // skupina udalosti musi existovat driv, nez na ni zacnou cekat sluzby
+    wifi_event_group = xEventGroupCreate();
+
+    _netif = esp_netif_create_default_wifi_sta();
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
 }
 
 void connect_wifi() {
     if (is_wifi_connected()) return;
 
-    esp_log_level_set("Connecting to WIFI", ESP_LOG_DEBUG);
-    //
-    // esp_netif_create_default_wifi_sta();
-    // wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    // ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-    //
-    // ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    //
-    wifi_event_group = xEventGroupCreate();
+    esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .name = "wifi_reconnect",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &_reconnect_timer));
+    _backoff_ms = WIFI_BACKOFF_MIN_MS;
 
     ESP_ERROR_CHECK(
         esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL));
     ESP_ERROR_CHECK(
-        esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL));
+        esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL));
 
-    wifi_config_t wifi_config = {
+    _wifi_config = (wifi_config_t) {
         .sta = {
             .ssid = WIFI_SSID,
             .password = WIFI_PASS,
+            .scan_method = WIFI_FAST_SCAN,
         },
     };
+    load_cached_ap(&_wifi_config);
+    apply_static_ip();
 
-    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
-    esp_wifi_connect(); // Uz byla esp_wifi_start v ESP-NOW
-
-    ESP_LOGI("WiFi", "Connecting to Wi-Fi: %s", wifi_config.sta.ssid);
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &_wifi_config));
 
-    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
-                                           WIFI_CONNECTED_BIT,
-                                           pdFALSE,
-                                           pdTRUE,
-                                           pdMS_TO_TICKS(20000));
+    ESP_LOGI("WiFi", "Connecting to Wi-Fi: %s", _wifi_config.sta.ssid);
 
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI("WiFi", "Connected!");
-    } else {
-        ESP_LOGE("WiFi", "Can not connect to WiFi.");
-    }
+    // pripojeni zacne v handleru WIFI_EVENT_STA_START
+    ESP_ERROR_CHECK(esp_wifi_start());
 }
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
 #define WIFI_SSID "......"
 #define WIFI_PASS "......"
 
+// prazdna WIFI_STATIC_IP = DHCP; staticka adresa usetri pri startu cekani na DHCP
+#define WIFI_STATIC_IP      ""
+#define WIFI_STATIC_NETMASK "255.255.255.0"
+#define WIFI_STATIC_GW      ""
+
 void init_wifi_radio();
 void connect_wifi();
 bool is_wifi_connected();
+bool wait_wifi_connected(TickType_t timeout);
 void disconnect_wifi();
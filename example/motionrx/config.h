@@ -1,12 +1,31 @@
 #pragma once
 
+#include "profile.h"
+
+// Obecna verze (make bez ID) - vsechny periferie, sensor_id z EEPROM
+#ifndef SENSOR_ID
+#define HAS_AM2302 1
+#define HAS_PIR 1
+#define HAS_RCWL 1
+#endif
+
+#define PROFILE_PIN_MASK ((HAS_PIR ? _BV(PCINT1) : 0) | (HAS_RCWL ? _BV(PCINT2) : 0))
+
 #define PIR_ACTIVATED (PINA & PA1)
 #define RCWL_ACTIVATED (PINA & PA2)
 
+#if HAS_AM2302
 #define AM2302_PORT PORTA
 #define AM2302_DDR DDRA
 #define AM2302_PIN PINA
 #define AM2302_BIT PA5
+#endif
+
+// main.S vyplni pri startu RAM od konce .bss, stack_free() v telemetry.c pocita neprepsane byty
+#define STACK_PAINT 0xC5
+
+// r25:r24 pro jmp_to_bootloader - bootloader pak neblika a hned vysle beacon (viz bootloader.S)
+#define BOOTLOADER_QUICK 0xB007
 
 #define DEBUG_LED_ON (DDRB |= _BV(PB1), PORTB |= _BV(PB1))
 #define DEBUG_LED_OFF (DDRB &= ~_BV(PB1), PORTB &= ~_BV(PB1))
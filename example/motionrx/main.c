@@ -7,19 +7,25 @@
 #include <util/delay.h>
 #include "config.h"
 #include "rx.h"
+#include "settings.h"
+#include "telemetry.h"
 
-#define FW_VERSION 0xBB
-
-#define TICKS_MESSAGE_WAIT 50
+#define FW_VERSION 0xBC
 
 #define FLAG_BOOT (1 << 0)
 #define FLAG_PIR (1 << 1)
 #define FLAG_RCWL (1 << 2)
 #define FLAG_WDT (1 << 3)
+#define FLAG_CMD (1 << 4) // odpoved na IR prikaz - viz settings.h
 
-static volatile uint8_t sensor_id;
+#ifdef SENSOR_ID
+static const uint8_t sensor_id = SENSOR_ID;
+#else
+static uint8_t sensor_id;
+#endif
 
 static volatile uint32_t wdt_tick = 0;
+static volatile uint8_t heartbeat_countdown = 0;
 
 static volatile uint8_t flags = 0;
 
@@ -35,10 +41,18 @@ typedef struct __attribute__((packed)) message
     uint8_t dummy;
 } message_t;
 
-void jmp_to_bootloader(void);
+void jmp_to_bootloader(uint16_t magic);
 void enable_watchdog(void);
-void rf_send(uint8_t *buf, uint8_t len);
-void speck_encrypt(uint8_t *buf);
+void rf_send(uint8_t *buf, uint8_t len, uint8_t line_code);
+// encrypt.S - CTR: keystream se spocita predem, pri odeslani se do nej data jen XORuji (dst_ks ^= src)
+// a sifrovany ramec vznikne na miste keystreamu
+void speck_ctr_keystream(uint8_t *ks, uint8_t blocks, uint8_t sensor_id, uint32_t msg_ctr, uint8_t domain);
+void speck_xor(uint8_t *dst_ks, const uint8_t *src, uint8_t len);
+
+#define CTR_DOMAIN_MESSAGE 0 // hlaseni i telemetrie - lisi se msg_id
+#define CTR_DOMAIN_ALERT 1   // poplach - stejne msg_id jako hlaseni, ktere po nem nasleduje
+#define CTR_HEADER_LEN 4     // otevrene sensor_id a 24bit citac zprav pred zasifrovanymi daty, viz sensormsg.h na brane
+#define CTR_ALERT_LEN 5      // poplach: zasifrovana kopie hlavicky a flags
 
 void debug()
 {
@@ -56,20 +70,33 @@ ISR(WDT_vect)
     enable_watchdog();
     
     wdt_tick++;
-    
-    if (wdt_tick % TICKS_MESSAGE_WAIT == 0)
+    TELEMETRY_COUNT(telemetry.wake_wdt);
+
+    // odpocet misto wdt_tick % N - bez 32bit deleni v preruseni
+    if (settings.ticks_message_wait && --heartbeat_countdown == 0)
     {
+        heartbeat_countdown = settings.ticks_message_wait;
         flags |= FLAG_WDT;
     }
 }
 
 ISR(PCINT0_vect)
 {
+#if HAS_RCWL
     if (RCWL_ACTIVATED)
+    {
         flags |= FLAG_RCWL;
+        TELEMETRY_COUNT(telemetry.wake_rcwl);
+    }
+#endif
 
+#if HAS_PIR
     if (PIR_ACTIVATED)
+    {
         flags |= FLAG_PIR;
+        TELEMETRY_COUNT(telemetry.wake_pir);
+    }
+#endif
 }
 
 void delay_ms_200()
@@ -100,16 +127,7 @@ uint16_t readVcc()
 
 void setup_gpio()
 {
-    switch (sensor_id)
-    {
-    case 14:
-        PCMSK0 = _BV(PCINT1);
-        break;
-    case 12:
-    default:
-        PCMSK0 = _BV(PCINT1) | _BV(PCINT2);
-        break;
-    }
+    PCMSK0 = settings.pin_mask & PROFILE_PIN_MASK; // jen piny, ktere deska ma
 
     PCMSK1 = _BV(PCINT10); // PB2
     GIMSK = _BV(PCIE0) | _BV(PCIE1);
@@ -120,63 +138,186 @@ void setup_gpio()
 
 #ifdef AM2302_BIT
 uint32_t am2302_read(void);
+
+static uint32_t am2302_read_measured(void)
+{
+    uint16_t start = telemetry_start();
+    uint32_t humitemp = am2302_read();
+    telemetry_stop(TELEMETRY_AM2302, start);
+    telemetry_am2302_result(humitemp);
+    return humitemp;
+}
 #endif
 
+// zprava jde dvakrat - prijimac na brane muze prvni propasnout
+static void rf_send_twice(uint8_t *buf, uint8_t len)
+{
+    uint16_t start = telemetry_start();
+    rf_send(buf, len, settings.rf_line_code);
+    telemetry_stop(TELEMETRY_RF, start);
+    delay_ms_200();
+    delay_ms_200();
+    start = telemetry_start();
+    rf_send(buf, len, settings.rf_line_code);
+    telemetry_stop(TELEMETRY_RF, start);
+    delay_ms_200();
+}
+
+// citac zprav ma 24 bitu - dolnich 16 je msg_id ve zprave, horni byte jen v hlavicce a citaci CTR
+static void ctr_header(uint8_t *frame, uint32_t msg_ctr)
+{
+    frame[0] = sensor_id;
+    frame[1] = msg_ctr;
+    frame[2] = msg_ctr >> 8;
+    frame[3] = msg_ctr >> 16;
+}
+
+// ramec CTR: frame[CTR_HEADER_LEN..] uz obsahuje data XORovana s keystreamem, doplnime otevrenou hlavicku
+static void rf_send_ctr(uint8_t *frame, uint32_t msg_ctr, uint8_t len)
+{
+    ctr_header(frame, msg_ctr);
+    rf_send_twice(frame, CTR_HEADER_LEN + len);
+}
+
+// Poplach pri pohybu hned po probuzeni - hlaseni ceka 200 ms na senzory a meri VCC a AM2302.
+// Jde jen jednou, plne hlaseni se stejnym msg_id je zaloha. Jeden blok keystreamu ~160 us.
+// Brana porovna desifrovanou kopii hlavicky s otevrenou jako u hlaseni.
+static void rf_send_alert(uint32_t msg_ctr, uint8_t alert_flags)
+{
+    uint8_t frame[CTR_HEADER_LEN + 8];
+
+    speck_ctr_keystream(frame + CTR_HEADER_LEN, 1, sensor_id, msg_ctr, CTR_DOMAIN_ALERT);
+    ctr_header(frame, msg_ctr);
+    speck_xor(frame + CTR_HEADER_LEN, frame, CTR_HEADER_LEN);
+    frame[2 * CTR_HEADER_LEN] ^= alert_flags;
+
+    uint16_t start = telemetry_start();
+    rf_send(frame, CTR_HEADER_LEN + CTR_ALERT_LEN, settings.rf_line_code);
+    telemetry_stop(TELEMETRY_RF, start);
+}
+
+// citac zprav je soucasti citace CTR - po restartu pokracujeme dalsim blokem 256 zprav.
+// 16bit epocha v EEPROM se zopakuje az po 65536 restartech nebo 2^24 zpravach.
+static uint32_t msg_ctr_start(void)
+{
+    uint16_t epoch = eeprom_read_word((uint16_t *)MSG_EPOCH_EEPROM_ADDR) + 1;
+    eeprom_update_word((uint16_t *)MSG_EPOCH_EEPROM_ADDR, epoch);
+    return (uint32_t)epoch << 8;
+}
+
+static void msg_ctr_advance(uint32_t *msg_ctr)
+{
+    *msg_ctr = (*msg_ctr + 1) & 0xFFFFFF;
+    if ((uint8_t)*msg_ctr == 0)
+        eeprom_update_word((uint16_t *)MSG_EPOCH_EEPROM_ADDR, *msg_ctr >> 8);
+}
+
 void main()
 {
-    if (MCUSR & _BV(EXTRF))
-        jmp_to_bootloader();
+    uint8_t reset_cause = MCUSR;
+
+    if (reset_cause & _BV(EXTRF))
+        jmp_to_bootloader(0); // tlacitko reset - bootloader zablika, at je videt, ze ceka
 
     MCUSR = 0;
     DDRA = 0;
     DDRB = 0;
 
-    setup_gpio();
+#ifdef SENSOR_ID
+    // beacon bootloaderu bere sensor_id z EEPROM - musi sedet s profilem
+    eeprom_update_byte((uint8_t *)SENSOR_ID_EEPROM_ADDR, SENSOR_ID);
+#else
+    sensor_id = eeprom_read_byte((uint8_t *)SENSOR_ID_EEPROM_ADDR);
+#endif
+    settings_load(sensor_id);
+    heartbeat_countdown = settings.ticks_message_wait;
 
-    sensor_id = eeprom_read_byte((uint8_t *)4);
+    setup_gpio();
 
-    debug();
+    // MCUSR == 0 - skok z bootloaderu po nahrani, vysilani uz skoncilo
+    if (reset_cause)
+    {
+        debug();
 
-    // musime pockat na dojezd predchozi komunikace, aby nas neposlala znovu do bootloaderu
-    _delay_ms(2000);
+        // musime pockat na dojezd predchozi komunikace, aby nas neposlala znovu do bootloaderu
+        _delay_ms(2000);
+    }
 
     enable_watchdog();
 
+    telemetry_init();
     ir_init();
     sei();
 
-    uint16_t msg_id = 0;
+    uint32_t msg_ctr = msg_ctr_start();
+    uint8_t telemetry_countdown = settings.telemetry_every;
+    uint8_t frame[RX_FRAME_MAX];
     while (1)
     {
-        if (flags || rx_buf_len/* && !send_delay*/)
+        uint32_t reply = 0;
+        uint8_t ticks_message_wait = settings.ticks_message_wait;
+        uint8_t telemetry_every = settings.telemetry_every;
+        uint8_t frame_len = ir_pop_frame(frame);
+        if (frame_len && settings_command(sensor_id, frame, frame_len, &reply))
+            flags |= FLAG_CMD;
+
+        // odpocty po zmene pres 'S' znovu - z vypnuteho (0) by prvni odecet pretekl na 255
+        if (settings.ticks_message_wait != ticks_message_wait)
+            heartbeat_countdown = settings.ticks_message_wait;
+        if (settings.telemetry_every != telemetry_every)
+            telemetry_countdown = settings.telemetry_every;
+
+        if (flags & (settings.report_flags | FLAG_CMD))
         {
+            uint8_t alert = flags & settings.report_flags & (FLAG_PIR | FLAG_RCWL);
+            if (alert)
+                rf_send_alert(msg_ctr, alert);
+
+            // keystream spocitame behem cekani na senzory, pri odeslani uz jen XOR
+            // ramec telemetrie zacina v ctr[sizeof(message_t)] - hlavicka prepise uz odeslany konec hlaseni
+            uint8_t ctr[CTR_HEADER_LEN + sizeof(message_t) + sizeof(telemetry_t)];
+            uint8_t telemetry_due = settings.telemetry_every && telemetry_countdown == 1;
+            speck_ctr_keystream(ctr + CTR_HEADER_LEN, sizeof(message_t) / 8, sensor_id, msg_ctr, CTR_DOMAIN_MESSAGE);
+            if (telemetry_due)
+                speck_ctr_keystream(ctr + CTR_HEADER_LEN + sizeof(message_t), sizeof(telemetry_t) / 8, sensor_id,
+                                    (msg_ctr + 1) & 0xFFFFFF, CTR_DOMAIN_MESSAGE);
+
             delay_ms_200(); // pockame na senzory - pripadnou zmenu flags
 
             message_t msg = {
                 .sensor_id = sensor_id,
-                .msg_id = msg_id,
+                .msg_id = msg_ctr,
                 .vcc = readVcc(),
                 .tick = wdt_tick,
                 .flags = flags,
                 .version = FW_VERSION,
-                .dummy = rx_buf_len,
+                .dummy = rx_dropped,
+            };
+
+            if (flags & FLAG_CMD)
+                msg.humitemp = reply;
 #ifdef AM2302_BIT
-                .humitemp = am2302_read(),
-#else
-                .humitemp = 0,
+            else
+                msg.humitemp = am2302_read_measured();
 #endif
-            };
 
-            speck_encrypt((uint8_t *)&msg);
-            speck_encrypt(((uint8_t *)&msg) + 8);
+            speck_xor(ctr + CTR_HEADER_LEN, (uint8_t *)&msg, sizeof(msg));
+            rf_send_ctr(ctr, msg_ctr, sizeof(msg));
+            msg_ctr_advance(&msg_ctr);
+
+            // po kazdem N-tem heartbeatu jeste telemetrie - brana ji pozna podle delky
+            // telemetry_due plati - telemetry_countdown se od vypoctu keystreamu nezmenil
+            if ((flags & FLAG_WDT) && settings.telemetry_every && --telemetry_countdown == 0)
+            {
+                telemetry_countdown = settings.telemetry_every;
 
-            rf_send((uint8_t *)&msg, 16);
-            delay_ms_200();
-            delay_ms_200();
-            rf_send((uint8_t *)&msg, 16);
-            delay_ms_200();
+                telemetry_t tm;
+                telemetry_take(sensor_id, msg_ctr, &tm);
+                speck_xor(ctr + CTR_HEADER_LEN + sizeof(message_t), (uint8_t *)&tm, sizeof(tm));
+                rf_send_ctr(ctr + sizeof(message_t), msg_ctr, sizeof(tm));
+                msg_ctr_advance(&msg_ctr);
+            }
 
-            msg_id++;
             // send_delay = MESSAGE_SEND_DELAY;
             // DEBUG_LED_OFF;
             ir_init();
@@ -184,7 +325,7 @@ void main()
 
         flags = 0;
 
-        if (!ir_comm_active)
+        if (!ir_comm_active && !rx_queue_count)
         {
             DEBUG_LED_OFF;
             ADCSRA &= ~(1 << ADEN); // vypiname ADC
@@ -192,5 +333,11 @@ void main()
             sleep_mode();
             DEBUG_LED_ON;
         }
+        else if (!rx_queue_count)
+        {
+            // prijem IR - Timer0 musi bezet, ale CPU muze spat do dalsi hrany nebo preteceni
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            sleep_mode();
+        }
     }
 }
\ No newline at end of file
@@ -4,15 +4,55 @@
 // 1 - pauza je 4x pocatecnimu aktivnimu impulzu
 // ukonceni komunikace - pulz je trojnasobny
 // Vyhoda - slave si muze casove synchronizovat na zaklade delky pocatecniho pulzu
+//
+// Sum (dalkove ovladace, slunce) probouzi senzor kazdou hranou. Prvni pulz relace proto musi mit delku
+// PULSE_LENGTH_US (okno PULSE_MIN_TICKS .. PULSE_MAX_TICKS), dalsi pulzy a pauzy nesmi byt kratsi nez
+// polovina synchronizacniho pulzu - jinak relaci hned ukoncime a main se vrati do power-down.
+// Prilis dlouhy prvni pulz ukonci compare A Timer0, neceka se na jeho konec.
 
 #include <stdint.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "config.h"
+#include "rx.h"
+#include "telemetry.h"
 
-void jmp_to_bootloader(void);
+void jmp_to_bootloader(uint16_t magic);
+
+#define PULSE_LENGTH_US 400 // jako socirnec.c na brane
+#define RX_TICK_US 8        // Timer0 /64
+#define PULSE_TICKS (PULSE_LENGTH_US / RX_TICK_US)
+#define PULSE_MIN_TICKS (PULSE_TICKS * 5 / 8) // IR prijimac pulzy zkracuje i prodluzuje
+#define PULSE_MAX_TICKS (PULSE_TICKS * 3 / 2)
+
+typedef struct
+{
+    uint8_t len;
+    uint8_t data[RX_FRAME_MAX];
+} rx_frame_t;
+
+// fronta prijatych ramcu - ISR pise do rx_queue[rx_queue_head + rx_queue_count], main je vyzvedava
+static volatile rx_frame_t rx_queue[RX_QUEUE_LEN];
+static volatile uint8_t rx_queue_head = 0;
+volatile uint8_t rx_queue_count = 0, rx_dropped = 0;
 
 volatile uint8_t rx_buf_index = 0, current_pulse_length = 0, rx_byte = 0, rx_bits = 0;
-volatile uint8_t rx_buf[10], rx_buf_len = 0, ir_comm_active = 0;
+volatile uint8_t ir_comm_active = 0;
+
+// prvni byty ramce mimo frontu - "BOOT" pozname i pri plne fronte
+static uint8_t rx_boot[4];
+
+// telemetrie - delka relace od prvni hrany do preteceni Timer0, relace bez ramce je sum
+static uint16_t session_start;
+static uint8_t session_frames;
+
+static volatile rx_frame_t *rx_slot(void)
+{
+    uint8_t ix = rx_queue_head + rx_queue_count;
+    if (ix >= RX_QUEUE_LEN)
+        ix -= RX_QUEUE_LEN;
+    return &rx_queue[ix];
+}
 
 static void got_bit(uint8_t bit)
 {
@@ -22,52 +62,121 @@ static void got_bit(uint8_t bit)
 
     if (++rx_bits == 8)
     {
-        rx_buf[rx_buf_index++] = rx_byte;
-
-        if (rx_buf_index >= sizeof(rx_buf))
-        {
-            // buffer je plny
-            rx_buf_len = rx_buf_index;
-        }
+        if (rx_buf_index < sizeof(rx_boot))
+            rx_boot[rx_buf_index] = rx_byte;
+        // pri plne fronte nebo prilis dlouhem ramci dalsi byty zahodime
+        if (rx_queue_count < RX_QUEUE_LEN && rx_buf_index < RX_FRAME_MAX)
+            rx_slot()->data[rx_buf_index] = rx_byte;
+        rx_buf_index++;
 
         rx_byte = 0;
         rx_bits = 0;
     }
 }
 
-ISR(PCINT1_vect)
+static void frame_finished(void)
+{
+    // "BOOT" ma prednost - musi projit i pri plne fronte
+    if (rx_buf_index == 4 && rx_boot[0] == 'B' && rx_boot[1] == 'O' && rx_boot[2] == 'O' && rx_boot[3] == 'T')
+        jmp_to_bootloader(BOOTLOADER_QUICK);
+
+    if (rx_queue_count >= RX_QUEUE_LEN || rx_buf_index > RX_FRAME_MAX)
+    {
+        rx_dropped++;
+        return;
+    }
+
+    volatile rx_frame_t *f = rx_slot();
+    f->len = rx_buf_index;
+
+    rx_queue_count++;
+    session_frames++;
+}
+
+static void session_end(void)
+{
+    if (ir_comm_active)
+    {
+        telemetry_stop(TELEMETRY_IR, session_start);
+        if (!session_frames)
+            TELEMETRY_COUNT(telemetry.wake_ir_noise);
+    }
+
+    rx_buf_index = 0;
+    rx_byte = 0;
+    rx_bits = 0;
+    ir_comm_active = 0;
+    current_pulse_length = 0;
+}
+
+uint8_t ir_pop_frame(uint8_t *buf)
 {
-    if (rx_buf_len)
-        return; // dokud si nevyzvedne vysledek, ignorujeme to
+    uint8_t len = 0;
+
+    cli();
+    if (rx_queue_count)
+    {
+        volatile rx_frame_t *f = &rx_queue[rx_queue_head];
+        len = f->len;
+        for (uint8_t i = 0; i < len; i++)
+            buf[i] = f->data[i];
+        if (++rx_queue_head >= RX_QUEUE_LEN)
+            rx_queue_head = 0;
+        rx_queue_count--;
+    }
+    sei();
+
+    return len;
+}
 
+ISR(PCINT1_vect)
+{
     uint8_t sestupna_hrana = (PINB & _BV(PB2)) == 0;
     uint8_t t = TCNT0;
     TCNT0 = 0;
 
     if (sestupna_hrana) // zacina synchronizacni pulz
     {
+        if (!ir_comm_active)
+        {
+            session_start = telemetry_start();
+            session_frames = 0;
+        }
         ir_comm_active = 1;
         if (current_pulse_length)
         {
+            // pauza kratsi nez bit 0 neni od brany
+            if (t < current_pulse_length / 2)
+            {
+                session_end();
+                return;
+            }
             // uz predchazel synchronizacni pulz - mame ted konec dalsiho bitu
             got_bit(t > 2 * current_pulse_length);
         }
     }
     else
     { // vzestupna hrana
+        if (!ir_comm_active)
+            return; // zacatek pulzu jsme nevideli (preteceni Timer0 nebo odmitnuta relace)
+
+        if (current_pulse_length ? t < current_pulse_length / 2 : t < PULSE_MIN_TICKS || t > PULSE_MAX_TICKS)
+        {
+            session_end(); // delka pulzu neodpovida - sum
+            return;
+        }
+
         if (current_pulse_length && (t > current_pulse_length * 2))
         {
             // aktualni pulz je prilis dlouhy - master oznamuje konec vysilani
-            rx_buf_len = rx_buf_index; // oznacime, ze mame data pripravena
-                                       
+            if (rx_buf_index)
+                frame_finished(); // ulozime ramec do fronty
+
             // pripravime se na dalsi komunikaci
             current_pulse_length = 0;
             rx_buf_index = 0;
             rx_byte = 0;
             rx_bits = 0;
-
-            if (rx_buf_len == 4 && rx_buf[0] == 'B' && rx_buf[1] == 'O' && rx_buf[2] == 'O' && rx_buf[3] == 'T')
-                jmp_to_bootloader();
         }
         else
         {
@@ -79,14 +188,17 @@ ISR(PCINT1_vect)
 
 ISR(TIM0_OVF_vect)
 {
-    rx_buf_index = 0;
-    rx_byte = 0;
-    rx_bits = 0;
-    ir_comm_active = 0;
-    current_pulse_length = 0;
+    session_end();
+}
+
+// PULSE_MAX_TICKS od posledni hrany - prvni pulz relace je stale aktivni, je prilis dlouhy
+ISR(TIM0_COMPA_vect)
+{
+    if (ir_comm_active && !current_pulse_length && !(PINB & _BV(PB2)))
+        session_end();
 }
 
-void ir_init() // vola se opakovane
+void ir_init() // vola se opakovane - fronta prijatych ramcu zustava
 {
     PCMSK1 |= _BV(PCINT10);
     GIMSK |= _BV(PCIE1);
@@ -95,14 +207,14 @@ void ir_init() // vola se opakovane
     TCCR0A = 0; // normal rezim
     TCCR0B = 3; // /64 : 1 tick - 8 uS
     TCNT0 = 0;
-    TIMSK0 |= (1 << TOIE0); // preruseni pri preteceni casovace
+    OCR0A = PULSE_MAX_TICKS;
+    TIMSK0 |= (1 << TOIE0) | (1 << OCIE0A); // preruseni pri preteceni casovace a konci okna prvniho pulzu
 
     // pripravime prenos
     rx_buf_index = 0;
     rx_byte = 0;
     rx_bits = 0;
     current_pulse_length = 0;
-    rx_buf_len = 0;
     ir_comm_active = 0;
 
     sei();
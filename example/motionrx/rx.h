@@ -2,6 +2,10 @@
 
 #include <stdint.h>
 
+#define RX_QUEUE_LEN 3  // kolik prijatych ramcu muze cekat na zpracovani
+#define RX_FRAME_MAX 10
+
 void ir_init();
-extern uint8_t rx_buf[10], rx_buf_len;
-extern uint8_t ir_comm_active;
\ No newline at end of file
+uint8_t ir_pop_frame(uint8_t *buf); // vraci delku ramce nebo 0, buf musi mit RX_FRAME_MAX bytu
+extern volatile uint8_t rx_queue_count, rx_dropped;
+extern volatile uint8_t ir_comm_active;
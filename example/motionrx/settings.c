@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "config.h"
+#include "settings.h"
+
+void jmp_to_bootloader(uint16_t magic);
+
+settings_t settings;
+
+// nenulovy zacatek - vynulovana EEPROM ma CRC od 0 take 0 a prosla by kontrolou
+#define SETTINGS_CRC_SEED 0x5A
+
+static uint8_t crc8(uint8_t crc, const uint8_t *buf, uint8_t len)
+{
+    while (len--)
+        crc = _crc_ibutton_update(crc, *buf++); // poly 0x8C - jako calc_crc v common.S
+    return crc;
+}
+
+static void settings_defaults(uint8_t sensor_id)
+{
+    settings.ticks_message_wait = 50;
+    settings.report_flags = 0xFF;
+    settings.telemetry_every = 0;
+    settings.rf_line_code = RF_LINE_CODE_4B6B;
+
+#ifdef SENSOR_ID
+    settings.pin_mask = PROFILE_PIN_MASK;
+#else
+    switch (sensor_id)
+    {
+    case 14:
+        settings.pin_mask = _BV(PCINT1);
+        break;
+    case 12:
+    default:
+        settings.pin_mask = _BV(PCINT1) | _BV(PCINT2);
+        break;
+    }
+#endif
+}
+
+void settings_load(uint8_t sensor_id)
+{
+    eeprom_read_block(&settings, (void *)SETTINGS_EEPROM_ADDR, sizeof(settings));
+
+    if (crc8(SETTINGS_CRC_SEED, (uint8_t *)&settings, sizeof(settings)) != 0)
+        settings_defaults(sensor_id);
+
+    // CRC muze nahodou sedet i na cizi obsah EEPROM - neznamy kod nebereme, NRZ by brana
+    // s RadioHead nedekodovala
+    if (settings.rf_line_code > RF_LINE_CODE_NRZ)
+        settings.rf_line_code = RF_LINE_CODE_4B6B;
+}
+
+static void settings_save(void)
+{
+    settings.crc = crc8(SETTINGS_CRC_SEED, (uint8_t *)&settings, sizeof(settings) - 1);
+    // update zapisuje jen zmenene byty - setrime EEPROM
+    eeprom_update_block(&settings, (void *)SETTINGS_EEPROM_ADDR, sizeof(settings));
+}
+
+static uint8_t *setting_ptr(uint8_t key)
+{
+    switch (key)
+    {
+    case SETTING_TICKS_MESSAGE_WAIT:
+        return &settings.ticks_message_wait;
+    case SETTING_PIN_MASK:
+        return &settings.pin_mask;
+    case SETTING_REPORT_FLAGS:
+        return &settings.report_flags;
+    case SETTING_TELEMETRY_EVERY:
+        return &settings.telemetry_every;
+    case SETTING_RF_LINE_CODE:
+        return &settings.rf_line_code;
+    }
+    return 0;
+}
+
+uint8_t settings_command(uint8_t sensor_id, const uint8_t *frame, uint8_t len, uint32_t *reply)
+{
+    if (len < 3 || crc8(0, frame, len) != 0)
+        return 0; // sum nebo poskozeny ramec - neodpovidame
+
+    if (frame[0] != sensor_id && frame[0] != SENSOR_ID_BROADCAST)
+        return 0;
+
+    uint8_t cmd = frame[1];
+    uint8_t key = len > 3 ? frame[2] : 0;
+    uint8_t *value = setting_ptr(key);
+
+    switch (cmd)
+    {
+    case 'B':
+        jmp_to_bootloader(BOOTLOADER_QUICK);
+        return 0;
+    case 'S':
+        if (!value || len != 5)
+            break;
+        if (key == SETTING_RF_LINE_CODE && frame[3] > RF_LINE_CODE_NRZ)
+            break;
+        *value = frame[3];
+        settings_save();
+        if (key == SETTING_PIN_MASK)
+            PCMSK0 = settings.pin_mask & PROFILE_PIN_MASK;
+        // fall-through - odpovime novou hodnotou
+    case 'G':
+        if (!value)
+            break;
+        *reply = (uint32_t)cmd << 24 | (uint32_t)key << 16 | *value;
+        return 1;
+    }
+
+    *reply = (uint32_t)'!' << 24 | (uint32_t)key << 16;
+    return 1;
+}
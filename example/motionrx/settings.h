@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+// Konfigurace senzoru v EEPROM (sensor_id je na adrese 4) - meni se prikazem pres IR (irnec),
+// neni potreba preflashovat.
+//
+// Prikaz: [sensor_id | 0xFF vsem] [prikaz] [parametry...] [CRC8 - stejne jako calc_crc]
+//   'G' key            - precti hodnotu
+//   'S' key value      - nastav hodnotu (1 B) a uloz do EEPROM
+//   'B'                - skok do bootloaderu (adresne, na rozdil od "BOOT")
+// Odpoved odchazi jako bezna zprava s FLAG_CMD, v humitemp je (prikaz << 24 | key << 16 | hodnota),
+// pri chybe je misto prikazu '!'.
+
+#define SETTINGS_EEPROM_ADDR 8
+#define SENSOR_ID_EEPROM_ADDR 4 // cte ho i bootloader do beaconu
+#define MSG_EPOCH_EEPROM_ADDR 5 // 16bit epocha (adresy 5 a 6) - horni bity citace CTR, po restartu se nesmi opakovat
+
+#define SETTING_TICKS_MESSAGE_WAIT 1
+#define SETTING_PIN_MASK 2
+#define SETTING_REPORT_FLAGS 3
+#define SETTING_TELEMETRY_EVERY 4
+#define SETTING_RF_LINE_CODE 5
+
+// kodovani ramcu na 433 MHz (sender.S) - NRZ je o tretinu kratsi, ale RadioHead prijimac ho nedekoduje
+#define RF_LINE_CODE_4B6B 0
+#define RF_LINE_CODE_NRZ 1
+
+#define SENSOR_ID_BROADCAST 0xFF
+
+typedef struct __attribute__((packed)) settings
+{
+    uint8_t ticks_message_wait; // heartbeat kazdych N probuzeni watchdogem (8 s), 0 - vypnuto
+    uint8_t pin_mask;           // PCMSK0 - ktere vstupy nas budi
+    uint8_t report_flags;       // ktere FLAG_* vyvolaji odeslani zpravy
+    uint8_t telemetry_every;    // telemetrie po kazdem N-tem heartbeatu, 0 - vypnuto
+    uint8_t rf_line_code;       // RF_LINE_CODE_*, 'S' jinou hodnotu odmitne
+    uint8_t crc;
+} settings_t;
+
+extern settings_t settings;
+
+void settings_load(uint8_t sensor_id);
+
+// zpracuje prikaz z IR, vraci 1 pokud se ma odeslat odpoved
+uint8_t settings_command(uint8_t sensor_id, const uint8_t *frame, uint8_t len, uint32_t *reply);
@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "rx.h"
+#include "telemetry.h"
+
+extern uint8_t _end; // konec .bss - od tud vyplnuje main.S
+
+volatile telemetry_t telemetry;
+volatile uint32_t telemetry_ticks[3];
+
+void telemetry_init(void)
+{
+    TCCR1A = 0;
+    TCCR1B = _BV(CS12) | _BV(CS10); // /1024 - 128 us, bez preruseni
+}
+
+static uint16_t stack_free(void)
+{
+    const uint8_t *p = &_end;
+    while (p <= (const uint8_t *)RAMEND && *p == STACK_PAINT)
+        p++;
+    return p - &_end;
+}
+
+static void telemetry_reset(void)
+{
+    memset((void *)&telemetry, 0, sizeof(telemetry));
+    memset((void *)telemetry_ticks, 0, sizeof(telemetry_ticks));
+}
+
+void telemetry_take(uint8_t sensor_id, uint16_t msg_id, telemetry_t *out)
+{
+    cli();
+    memcpy(out, (const void *)&telemetry, sizeof(*out));
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uint32_t ms = telemetry_ticks[i] * 16 / 125; // 128 us na tick
+        out->active_ms[i] = ms > 0xFFFF ? 0xFFFF : ms;
+    }
+    telemetry_reset();
+    sei();
+
+    out->sensor_id = sensor_id;
+    out->msg_id = msg_id;
+    out->type = TELEMETRY_TYPE;
+    out->stack_free = stack_free();
+    out->rx_dropped = rx_dropped;
+}
+
+void telemetry_am2302_result(uint32_t humitemp)
+{
+    // chyba je jen kod v nejnizsim bytu, zbytek je nulovy
+    if ((humitemp >> 8) == 0 && (uint8_t)humitemp >= 0xFD && telemetry.am2302_err[(uint8_t)humitemp - 0xFD] != 0xFF)
+        telemetry.am2302_err[(uint8_t)humitemp - 0xFD]++;
+}
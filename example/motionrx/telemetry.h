@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <avr/io.h>
+
+// Provozni telemetrie - posila se misto bezne zpravy kazdych settings.telemetry_every heartbeatu
+// jako samostatny ramec - hlavicka CTR a 24 B (3 bloky SPECK). Brana ho rozpozna podle delky.
+//
+// Aktivni cas se meri Timer1 (/1024 - 128 us na tick), ktery v power-down stoji,
+// takze se scitaji jen useky, kdy CPU bezi.
+
+#define TELEMETRY_TYPE 0x54 // 'T' - verze formatu
+
+#define TELEMETRY_AM2302 0
+#define TELEMETRY_RF 1
+#define TELEMETRY_IR 2
+
+typedef struct __attribute__((packed)) telemetry
+{
+    uint8_t sensor_id;
+    uint16_t msg_id;
+    uint8_t type;         // TELEMETRY_TYPE
+    uint16_t stack_free;  // nejmene volnych bytu mezi .bss a zasobnikem od startu
+    uint16_t active_ms[3]; // AM2302, RF vysilani, IR prijem - od posledniho hlaseni
+    uint16_t wake_wdt;
+    uint16_t wake_pir;
+    uint16_t wake_rcwl;
+    uint16_t wake_ir_noise; // IR probuzeni bez platneho ramce - vcetne odmitnutych hned podle delky pulzu
+    uint8_t am2302_err[3]; // 0xFD timeout, 0xFE checksum, 0xFF bez senzoru
+    uint8_t rx_dropped;
+} telemetry_t;
+
+extern volatile telemetry_t telemetry;
+extern volatile uint32_t telemetry_ticks[3];
+
+void telemetry_init(void);
+// zkopiruje citace do out (preruseni mezitim pocitaji dal) a vynuluje je
+void telemetry_take(uint8_t sensor_id, uint16_t msg_id, telemetry_t *out);
+void telemetry_am2302_result(uint32_t humitemp);
+
+static inline uint16_t telemetry_start(void)
+{
+    return TCNT1;
+}
+
+static inline void telemetry_stop(uint8_t what, uint16_t start)
+{
+    telemetry_ticks[what] += (uint16_t)(TCNT1 - start);
+}
+
+// citace se zastavi na maximu, neprotecou
+#define TELEMETRY_COUNT(counter) \
+    do                           \
+    {                            \
+        if ((counter) != 0xFFFF) \
+            (counter)++;         \
+    } while (0)
@@ -0,0 +1,467 @@
+#include <string.h>
+#include "avrsim.h"
+
+#define SREG_C 0
+#define SREG_Z 1
+#define SREG_N 2
+#define SREG_V 3
+#define SREG_S 4
+#define SREG_H 5
+#define SREG_T 6
+#define SREG_I 7
+
+#define R(n)   (sim->data[(n)])
+#define SREG   (sim->data[0x20 + AVRSIM_IO_SREG])
+#define FLAG(f) ((SREG >> (f)) & 1)
+#define BIT(x, n) (((x) >> (n)) & 1)
+#define NBIT(x, n) (BIT(x, n) ^ 1)
+
+void avrsim_init(avrsim_t *sim) {
+    memset(sim, 0, sizeof(*sim));
+    memset(sim->flash, 0xFF, sizeof(sim->flash));
+    memset(sim->eeprom, 0xFF, sizeof(sim->eeprom));
+    avrsim_reset(sim);
+}
+
+void avrsim_reset(avrsim_t *sim) {
+    memset(sim->data, 0, sizeof(sim->data));
+    memset(sim->page_buf, 0xFF, sizeof(sim->page_buf));
+    sim->pc = 0;
+    sim->tcnt0_base = 0;
+    sim->tcnt0_cycle = sim->cycles;
+}
+
+static void set_flag(avrsim_t *sim, int flag, int value) {
+    if (value)
+        SREG |= 1 << flag;
+    else
+        SREG &= ~(1 << flag);
+}
+
+static void set_nzs(avrsim_t *sim, uint8_t r) {
+    set_flag(sim, SREG_N, BIT(r, 7));
+    set_flag(sim, SREG_Z, r == 0);
+    set_flag(sim, SREG_S, FLAG(SREG_N) ^ FLAG(SREG_V));
+}
+
+// ----------------------------- Timer0 -----------------------------
+
+static uint32_t timer0_prescaler(avrsim_t *sim) {
+    static const uint32_t presc[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+    return presc[sim->data[0x20 + AVRSIM_IO_TCCR0B] & 7];
+}
+
+static uint8_t timer0_value(avrsim_t *sim) {
+    uint32_t presc = timer0_prescaler(sim);
+    if (!presc) return sim->tcnt0_base;
+    return (uint8_t)(sim->tcnt0_base + (sim->cycles - sim->tcnt0_cycle) / presc);
+}
+
+// ----------------------------- I/O -----------------------------
+
+uint8_t avrsim_io_read(avrsim_t *sim, uint8_t io_addr) {
+    switch (io_addr) {
+        case AVRSIM_IO_PINA:
+        case AVRSIM_IO_PINB: {
+            uint8_t port = io_addr == AVRSIM_IO_PINA ? 'A' : 'B';
+            uint8_t ddr = sim->data[0x20 + io_addr + 1];
+            uint8_t out = sim->data[0x20 + io_addr + 2];
+            uint8_t in = sim->pin_reader ? sim->pin_reader(sim->ctx, port, sim->cycles) : 0;
+            // vystupni piny ctou sve vlastni nastaveni
+            return (out & ddr) | (in & ~ddr);
+        }
+        case AVRSIM_IO_TCNT0:
+            return timer0_value(sim);
+        default:
+            return sim->data[0x20 + io_addr];
+    }
+}
+
+void avrsim_io_write(avrsim_t *sim, uint8_t io_addr, uint8_t value) {
+    switch (io_addr) {
+        case AVRSIM_IO_TCNT0:
+            sim->tcnt0_base = value;
+            sim->tcnt0_cycle = sim->cycles;
+            break;
+        case AVRSIM_IO_TCCR0B:
+            // zachovame aktualni stav citace pred zmenou delicky
+            sim->tcnt0_base = timer0_value(sim);
+            sim->tcnt0_cycle = sim->cycles;
+            sim->data[0x20 + io_addr] = value;
+            break;
+        case AVRSIM_IO_EECR:
+            if (value & 1) { // EERE - cteni EEPROM
+                uint16_t addr = (sim->data[0x20 + AVRSIM_IO_EEARH] << 8 | sim->data[0x20 + AVRSIM_IO_EEARL]);
+                sim->data[0x20 + AVRSIM_IO_EEDR] = sim->eeprom[addr % AVRSIM_EEPROM_SIZE];
+                sim->cycles += 4;
+            }
+            break;
+        case AVRSIM_IO_DDRA:
+        case AVRSIM_IO_PORTA:
+        case AVRSIM_IO_DDRB:
+        case AVRSIM_IO_PORTB:
+            sim->data[0x20 + io_addr] = value;
+            if (sim->port_writer) sim->port_writer(sim->ctx, io_addr, value, sim->cycles);
+            break;
+        default:
+            sim->data[0x20 + io_addr] = value;
+    }
+}
+
+static uint8_t data_read(avrsim_t *sim, uint16_t addr) {
+    if (addr >= 0x20 && addr < 0x60) return avrsim_io_read(sim, addr - 0x20);
+    return sim->data[addr % AVRSIM_DATA_SIZE];
+}
+
+static void data_write(avrsim_t *sim, uint16_t addr, uint8_t value) {
+    if (addr >= 0x20 && addr < 0x60) avrsim_io_write(sim, addr - 0x20, value);
+    else sim->data[addr % AVRSIM_DATA_SIZE] = value;
+}
+
+// ----------------------------- zasobnik -----------------------------
+
+static uint16_t get_sp(avrsim_t *sim) {
+    return sim->data[0x20 + AVRSIM_IO_SPH] << 8 | sim->data[0x20 + AVRSIM_IO_SPL];
+}
+
+static void set_sp(avrsim_t *sim, uint16_t sp) {
+    sim->data[0x20 + AVRSIM_IO_SPH] = sp >> 8;
+    sim->data[0x20 + AVRSIM_IO_SPL] = sp & 0xFF;
+}
+
+static void push8(avrsim_t *sim, uint8_t v) {
+    uint16_t sp = get_sp(sim);
+    data_write(sim, sp, v);
+    set_sp(sim, sp - 1);
+}
+
+static uint8_t pop8(avrsim_t *sim) {
+    uint16_t sp = get_sp(sim) + 1;
+    set_sp(sim, sp);
+    return data_read(sim, sp);
+}
+
+static void push_pc(avrsim_t *sim, uint16_t pc) {
+    push8(sim, pc & 0xFF);
+    push8(sim, pc >> 8);
+}
+
+static uint16_t pop_pc(avrsim_t *sim) {
+    uint16_t hi = pop8(sim);
+    return hi << 8 | pop8(sim);
+}
+
+// ----------------------------- SPM -----------------------------
+
+static void do_spm(avrsim_t *sim) {
+    uint8_t cmd = sim->data[0x20 + AVRSIM_IO_SPMCSR] & 0x1F;
+    uint16_t z = R(31) << 8 | R(30);
+    uint16_t page = z & (AVRSIM_FLASH_SIZE - 1) & ~(AVRSIM_PAGE_SIZE - 1);
+
+    switch (cmd) {
+        case 0x01: // plneni bufferu stranky - r1:r0
+            sim->page_buf[(z >> 1) & (AVRSIM_PAGE_SIZE / 2 - 1)] &= R(1) << 8 | R(0);
+            break;
+        case 0x03: // mazani stranky
+            memset(sim->flash + page, 0xFF, AVRSIM_PAGE_SIZE);
+            sim->cycles += AVRSIM_SPM_CYCLES;
+            sim->spm_erases++;
+            break;
+        case 0x05: // zapis stranky - flash umi jen nulovat bity
+            for (int i = 0; i < AVRSIM_PAGE_SIZE / 2; i++) {
+                sim->flash[page + 2 * i] &= sim->page_buf[i] & 0xFF;
+                sim->flash[page + 2 * i + 1] &= sim->page_buf[i] >> 8;
+            }
+            memset(sim->page_buf, 0xFF, sizeof(sim->page_buf));
+            sim->cycles += AVRSIM_SPM_CYCLES;
+            sim->spm_writes++;
+            break;
+        case 0x11: // CTPB - vymaz bufferu
+            memset(sim->page_buf, 0xFF, sizeof(sim->page_buf));
+            break;
+    }
+    sim->data[0x20 + AVRSIM_IO_SPMCSR] &= ~0x1F;
+}
+
+// ----------------------------- jadro -----------------------------
+
+static uint16_t fetch(avrsim_t *sim, uint16_t pc) {
+    uint16_t a = (pc * 2) & (AVRSIM_FLASH_SIZE - 1);
+    return sim->flash[a] | sim->flash[a + 1] << 8;
+}
+
+static int is_two_word(uint16_t op) {
+    return (op & 0xFC0F) == 0x9000 /* lds/sts */ || (op & 0xFE0C) == 0x940C /* jmp/call */;
+}
+
+static void skip_next(avrsim_t *sim) {
+    uint16_t next = fetch(sim, sim->pc);
+    int words = is_two_word(next) ? 2 : 1;
+    sim->pc += words;
+    sim->cycles += words;
+}
+
+static uint8_t do_add(avrsim_t *sim, uint8_t d, uint8_t r, uint8_t carry) {
+    uint8_t res = d + r + carry;
+    set_flag(sim, SREG_H, (BIT(d, 3) & BIT(r, 3)) | (BIT(r, 3) & NBIT(res, 3)) | (NBIT(res, 3) & BIT(d, 3)));
+    set_flag(sim, SREG_V, (BIT(d, 7) & BIT(r, 7) & NBIT(res, 7)) | (NBIT(d, 7) & NBIT(r, 7) & BIT(res, 7)));
+    set_flag(sim, SREG_C, (BIT(d, 7) & BIT(r, 7)) | (BIT(r, 7) & NBIT(res, 7)) | (NBIT(res, 7) & BIT(d, 7)));
+    set_nzs(sim, res);
+    return res;
+}
+
+// keep_z - pro sbc/sbci/cpc, kde Z zustava jen pokud byl nastaven
+static uint8_t do_sub(avrsim_t *sim, uint8_t d, uint8_t r, uint8_t carry, int keep_z) {
+    uint8_t res = d - r - carry;
+    int z = FLAG(SREG_Z);
+    set_flag(sim, SREG_H, (NBIT(d, 3) & BIT(r, 3)) | (BIT(r, 3) & BIT(res, 3)) | (BIT(res, 3) & NBIT(d, 3)));
+    set_flag(sim, SREG_V, (BIT(d, 7) & NBIT(r, 7) & NBIT(res, 7)) | (NBIT(d, 7) & BIT(r, 7) & BIT(res, 7)));
+    set_flag(sim, SREG_C, (NBIT(d, 7) & BIT(r, 7)) | (BIT(r, 7) & BIT(res, 7)) | (BIT(res, 7) & NBIT(d, 7)));
+    set_nzs(sim, res);
+    if (keep_z) set_flag(sim, SREG_Z, z && res == 0);
+    return res;
+}
+
+static uint8_t do_logic(avrsim_t *sim, uint8_t res) {
+    set_flag(sim, SREG_V, 0);
+    set_nzs(sim, res);
+    return res;
+}
+
+static void branch(avrsim_t *sim, uint16_t op, int cond) {
+    if (cond) {
+        int8_t k = (int8_t)(((op >> 3) & 0x7F) << 1) >> 1;
+        sim->pc += k;
+        sim->cycles++;
+    }
+}
+
+avrsim_status_t avrsim_step(avrsim_t *sim) {
+    uint16_t op = fetch(sim, sim->pc);
+    uint8_t d = (op >> 4) & 0x1F;
+    uint8_t r = (op & 0x0F) | ((op >> 5) & 0x10);
+    uint8_t dh = 16 + ((op >> 4) & 0x0F);
+    uint8_t k8 = ((op >> 4) & 0xF0) | (op & 0x0F);
+
+    sim->pc++;
+    sim->cycles++;
+
+    switch (op & 0xFC00) {
+        case 0x0000:
+            if (op == 0x0000) return AVRSIM_OK; // nop
+            if ((op & 0xFF00) == 0x0100) { // movw
+                uint8_t dd = ((op >> 4) & 0x0F) * 2, rr = (op & 0x0F) * 2;
+                R(dd) = R(rr);
+                R(dd + 1) = R(rr + 1);
+                return AVRSIM_OK;
+            }
+            return AVRSIM_BAD_OPCODE;
+        case 0x0400: do_sub(sim, R(d), R(r), FLAG(SREG_C), 1); return AVRSIM_OK;         // cpc
+        case 0x0800: R(d) = do_sub(sim, R(d), R(r), FLAG(SREG_C), 1); return AVRSIM_OK;  // sbc
+        case 0x0C00: R(d) = do_add(sim, R(d), R(r), 0); return AVRSIM_OK;                // add/lsl
+        case 0x1000: // cpse
+            if (R(d) == R(r)) skip_next(sim);
+            return AVRSIM_OK;
+        case 0x1400: do_sub(sim, R(d), R(r), 0, 0); return AVRSIM_OK;                    // cp
+        case 0x1800: R(d) = do_sub(sim, R(d), R(r), 0, 0); return AVRSIM_OK;             // sub
+        case 0x1C00: R(d) = do_add(sim, R(d), R(r), FLAG(SREG_C)); return AVRSIM_OK;     // adc/rol
+        case 0x2000: R(d) = do_logic(sim, R(d) & R(r)); return AVRSIM_OK;                // and/tst
+        case 0x2400: R(d) = do_logic(sim, R(d) ^ R(r)); return AVRSIM_OK;                // eor/clr
+        case 0x2800: R(d) = do_logic(sim, R(d) | R(r)); return AVRSIM_OK;                // or
+        case 0x2C00: R(d) = R(r); return AVRSIM_OK;                                      // mov
+    }
+
+    switch (op & 0xF000) {
+        case 0x3000: do_sub(sim, R(dh), k8, 0, 0); return AVRSIM_OK;                     // cpi
+        case 0x4000: R(dh) = do_sub(sim, R(dh), k8, FLAG(SREG_C), 1); return AVRSIM_OK;  // sbci
+        case 0x5000: R(dh) = do_sub(sim, R(dh), k8, 0, 0); return AVRSIM_OK;             // subi
+        case 0x6000: R(dh) = do_logic(sim, R(dh) | k8); return AVRSIM_OK;                // ori
+        case 0x7000: R(dh) = do_logic(sim, R(dh) & k8); return AVRSIM_OK;                // andi
+        case 0xE000: R(dh) = k8; return AVRSIM_OK;                                       // ldi
+        case 0xC000: // rjmp
+            sim->pc += (int16_t)(op << 4) >> 4;
+            sim->cycles++;
+            return AVRSIM_OK;
+        case 0xD000: // rcall
+            push_pc(sim, sim->pc);
+            sim->pc += (int16_t)(op << 4) >> 4;
+            sim->cycles += 2;
+            return AVRSIM_OK;
+        case 0xB000: { // in/out
+            uint8_t a = (op & 0x0F) | ((op >> 5) & 0x30);
+            if (op & 0x0800) avrsim_io_write(sim, a, R(d));
+            else R(d) = avrsim_io_read(sim, a);
+            return AVRSIM_OK;
+        }
+        case 0x8000:
+        case 0xA000: { // ldd/std Y+q, Z+q
+            uint8_t q = (op & 7) | ((op >> 7) & 0x18) | ((op >> 8) & 0x20);
+            uint16_t base = (op & 0x08) ? (R(29) << 8 | R(28)) : (R(31) << 8 | R(30));
+            if (op & 0x0200) data_write(sim, base + q, R(d));
+            else R(d) = data_read(sim, base + q);
+            sim->cycles++;
+            return AVRSIM_OK;
+        }
+        case 0xF000:
+            switch (op & 0x0E00) {
+                case 0x0000: case 0x0200: branch(sim, op, BIT(SREG, op & 7)); break;   // brbs
+                case 0x0400: case 0x0600: branch(sim, op, NBIT(SREG, op & 7)); break;  // brbc
+                case 0x0800: // bld
+                    if (FLAG(SREG_T)) R(d) |= 1 << (op & 7);
+                    else R(d) &= ~(1 << (op & 7));
+                    break;
+                case 0x0A00: set_flag(sim, SREG_T, BIT(R(d), op & 7)); break;          // bst
+                case 0x0C00: if (NBIT(R(d), op & 7)) skip_next(sim); break;            // sbrc
+                case 0x0E00: if (BIT(R(d), op & 7)) skip_next(sim); break;             // sbrs (i prazdna flash 0xFFFF)
+            }
+            return AVRSIM_OK;
+    }
+
+    // 0x9xxx
+    switch (op & 0xFE0F) {
+        case 0x9000: // lds
+            R(d) = data_read(sim, fetch(sim, sim->pc++));
+            sim->cycles++;
+            return AVRSIM_OK;
+        case 0x9200: // sts
+            data_write(sim, fetch(sim, sim->pc++), R(d));
+            sim->cycles++;
+            return AVRSIM_OK;
+        case 0x9001: case 0x9002: case 0x9009: case 0x900A: case 0x900C: case 0x900D: case 0x900E:
+        case 0x9201: case 0x9202: case 0x9209: case 0x920A: case 0x920C: case 0x920D: case 0x920E: {
+            // ld/st s X, Y, Z s post-inkrementem a pre-dekrementem
+            uint8_t mode = op & 0x0F;
+            uint8_t lo = mode >= 0x0C ? 26 : (mode >= 0x09 ? 28 : 30);
+            uint16_t ptr = R(lo + 1) << 8 | R(lo);
+            uint8_t kind = mode >= 0x0C ? mode - 0x0C : (mode >= 0x09 ? mode - 0x08 : mode);
+            if (kind == 2) ptr--;
+            if (op & 0x0200) data_write(sim, ptr, R(d));
+            else R(d) = data_read(sim, ptr);
+            if (kind == 1) ptr++;
+            if (kind) {
+                R(lo) = ptr & 0xFF;
+                R(lo + 1) = ptr >> 8;
+            }
+            sim->cycles++;
+            return AVRSIM_OK;
+        }
+        case 0x9004: case 0x9005: { // lpm Rd, Z / Z+
+            uint16_t z = R(31) << 8 | R(30);
+            R(d) = sim->flash[z & (AVRSIM_FLASH_SIZE - 1)];
+            if (op & 1) {
+                z++;
+                R(30) = z & 0xFF;
+                R(31) = z >> 8;
+            }
+            sim->cycles += 2;
+            return AVRSIM_OK;
+        }
+        case 0x900F: R(d) = pop8(sim); sim->cycles++; return AVRSIM_OK;  // pop
+        case 0x920F: push8(sim, R(d)); sim->cycles++; return AVRSIM_OK;  // push
+        case 0x9400: // com
+            R(d) = do_logic(sim, ~R(d));
+            set_flag(sim, SREG_C, 1);
+            set_nzs(sim, R(d));
+            return AVRSIM_OK;
+        case 0x9401: { // neg
+            uint8_t res = do_sub(sim, 0, R(d), 0, 0);
+            R(d) = res;
+            return AVRSIM_OK;
+        }
+        case 0x9402: R(d) = (R(d) << 4) | (R(d) >> 4); return AVRSIM_OK; // swap
+        case 0x9403: // inc
+            R(d)++;
+            set_flag(sim, SREG_V, R(d) == 0x80);
+            set_nzs(sim, R(d));
+            return AVRSIM_OK;
+        case 0x940A: // dec
+            R(d)--;
+            set_flag(sim, SREG_V, R(d) == 0x7F);
+            set_nzs(sim, R(d));
+            return AVRSIM_OK;
+        case 0x9405: case 0x9406: case 0x9407: { // asr, lsr, ror
+            uint8_t v = R(d);
+            uint8_t top = (op & 0x0F) == 0x05 ? (v & 0x80) : ((op & 0x0F) == 0x07 ? FLAG(SREG_C) << 7 : 0);
+            R(d) = (v >> 1) | top;
+            set_flag(sim, SREG_C, v & 1);
+            set_flag(sim, SREG_N, BIT(R(d), 7));
+            set_flag(sim, SREG_V, FLAG(SREG_N) ^ FLAG(SREG_C));
+            set_flag(sim, SREG_Z, R(d) == 0);
+            set_flag(sim, SREG_S, FLAG(SREG_N) ^ FLAG(SREG_V));
+            return AVRSIM_OK;
+        }
+    }
+
+    switch (op) {
+        case 0x9409: // ijmp
+            sim->pc = R(31) << 8 | R(30);
+            sim->cycles++;
+            return AVRSIM_OK;
+        case 0x9509: // icall
+            push_pc(sim, sim->pc);
+            sim->pc = R(31) << 8 | R(30);
+            sim->cycles += 2;
+            return AVRSIM_OK;
+        case 0x9508: // ret
+            sim->pc = pop_pc(sim);
+            sim->cycles += 3;
+            return AVRSIM_OK;
+        case 0x9518: // reti
+            sim->pc = pop_pc(sim);
+            set_flag(sim, SREG_I, 1);
+            sim->cycles += 3;
+            return AVRSIM_OK;
+        case 0x95A8: return AVRSIM_OK;    // wdr - watchdog nesimulujeme
+        case 0x9588: return AVRSIM_SLEEP; // sleep
+        case 0x95C8: // lpm (r0)
+            R(0) = sim->flash[(R(31) << 8 | R(30)) & (AVRSIM_FLASH_SIZE - 1)];
+            sim->cycles += 2;
+            return AVRSIM_OK;
+        case 0x95E8: // spm
+            do_spm(sim);
+            sim->cycles += 3;
+            return AVRSIM_OK;
+    }
+
+    if ((op & 0xFF0F) == 0x9408) { // bset / bclr (sec, sei, set, clt, cli, ...)
+        set_flag(sim, (op >> 4) & 7, !(op & 0x80));
+        return AVRSIM_OK;
+    }
+
+    if ((op & 0xFE00) == 0x9600) { // adiw / sbiw
+        uint8_t lo = 24 + ((op >> 4) & 3) * 2;
+        uint8_t k = (op & 0x0F) | ((op >> 2) & 0x30);
+        uint16_t v = R(lo + 1) << 8 | R(lo);
+        uint16_t res;
+        if (op & 0x0100) {
+            res = v - k;
+            set_flag(sim, SREG_V, BIT(v, 15) & NBIT(res, 15));
+            set_flag(sim, SREG_C, BIT(res, 15) & NBIT(v, 15));
+        } else {
+            res = v + k;
+            set_flag(sim, SREG_V, NBIT(v, 15) & BIT(res, 15));
+            set_flag(sim, SREG_C, NBIT(res, 15) & BIT(v, 15));
+        }
+        set_flag(sim, SREG_N, BIT(res, 15));
+        set_flag(sim, SREG_Z, res == 0);
+        set_flag(sim, SREG_S, FLAG(SREG_N) ^ FLAG(SREG_V));
+        R(lo) = res & 0xFF;
+        R(lo + 1) = res >> 8;
+        sim->cycles++;
+        return AVRSIM_OK;
+    }
+
+    if ((op & 0xFC00) == 0x9800) { // cbi, sbic, sbi, sbis
+        uint8_t a = (op >> 3) & 0x1F, b = op & 7;
+        switch (op & 0xFF00) {
+            case 0x9800: avrsim_io_write(sim, a, sim->data[0x20 + a] & ~(1 << b)); sim->cycles++; break;
+            case 0x9A00: avrsim_io_write(sim, a, sim->data[0x20 + a] | (1 << b)); sim->cycles++; break;
+            case 0x9900: if (NBIT(avrsim_io_read(sim, a), b)) skip_next(sim); break;
+            case 0x9B00: if (BIT(avrsim_io_read(sim, a), b)) skip_next(sim); break;
+        }
+        return AVRSIM_OK;
+    }
+
+    sim->pc--;
+    return AVRSIM_BAD_OPCODE;
+}
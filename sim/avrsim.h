@@ -0,0 +1,80 @@
+#pragma once
+
+// Minimalni simulator ATtiny84 pro host - staci na beh bootloaderu (bez preruseni).
+// Simuluje jadro AVR (podmnozina instrukci, kterou generuje avr-gcc a nase assemblery),
+// Timer0 v normal rezimu, SPM (plneni bufferu, mazani a zapis stranky) a EEPROM cteni.
+// Vstupni piny a zapisy na porty se predavaji pres callbacky, cas je v taktech CPU.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AVRSIM_F_CPU        8000000UL
+#define AVRSIM_FLASH_SIZE   8192
+#define AVRSIM_PAGE_SIZE    64
+#define AVRSIM_RAMEND       0x25F
+#define AVRSIM_DATA_SIZE    (AVRSIM_RAMEND + 1)
+#define AVRSIM_EEPROM_SIZE  512
+
+// doba mazani/zapisu stranky - CPU je po tuto dobu zastaveno
+#define AVRSIM_SPM_CYCLES   (AVRSIM_F_CPU / 1000 * 45 / 10)
+
+// I/O adresy (I/O prostor, ne datovy)
+#define AVRSIM_IO_PINB    0x16
+#define AVRSIM_IO_DDRB    0x17
+#define AVRSIM_IO_PORTB   0x18
+#define AVRSIM_IO_PINA    0x19
+#define AVRSIM_IO_DDRA    0x1A
+#define AVRSIM_IO_PORTA   0x1B
+#define AVRSIM_IO_EECR    0x1C
+#define AVRSIM_IO_EEDR    0x1D
+#define AVRSIM_IO_EEARL   0x1E
+#define AVRSIM_IO_EEARH   0x1F
+#define AVRSIM_IO_WDTCSR  0x21
+#define AVRSIM_IO_TCCR0A  0x30
+#define AVRSIM_IO_TCNT0   0x32
+#define AVRSIM_IO_TCCR0B  0x33
+#define AVRSIM_IO_MCUSR   0x34
+#define AVRSIM_IO_SPMCSR  0x37
+#define AVRSIM_IO_SPL     0x3D
+#define AVRSIM_IO_SPH     0x3E
+#define AVRSIM_IO_SREG    0x3F
+
+typedef enum {
+    AVRSIM_OK = 0,
+    AVRSIM_SLEEP,           // provedena instrukce sleep
+    AVRSIM_BAD_OPCODE,      // instrukce, kterou simulator nezna
+} avrsim_status_t;
+
+typedef struct avrsim avrsim_t;
+
+// vraci uroven pinu (0/1) portu 'A' nebo 'B' v case 'cycle'
+typedef uint8_t (*avrsim_pin_reader)(void *ctx, char port, uint64_t cycle);
+// zavola se pri kazdem zapisu do PORTx/DDRx
+typedef void (*avrsim_port_writer)(void *ctx, uint8_t io_addr, uint8_t value, uint64_t cycle);
+
+struct avrsim {
+    uint8_t flash[AVRSIM_FLASH_SIZE];
+    uint8_t data[AVRSIM_DATA_SIZE];     // r0-r31, I/O 0x20-0x5F, SRAM 0x60-RAMEND
+    uint8_t eeprom[AVRSIM_EEPROM_SIZE];
+    uint16_t page_buf[AVRSIM_PAGE_SIZE / 2];
+
+    uint16_t pc;                        // adresa ve wordech
+    uint64_t cycles;
+
+    uint8_t tcnt0_base;                 // TCNT0 v case tcnt0_cycle
+    uint64_t tcnt0_cycle;
+
+    uint32_t spm_erases;
+    uint32_t spm_writes;
+
+    avrsim_pin_reader pin_reader;
+    avrsim_port_writer port_writer;
+    void *ctx;
+};
+
+void avrsim_init(avrsim_t *sim);
+void avrsim_reset(avrsim_t *sim);
+avrsim_status_t avrsim_step(avrsim_t *sim);
+
+uint8_t avrsim_io_read(avrsim_t *sim, uint8_t io_addr);
+void avrsim_io_write(avrsim_t *sim, uint8_t io_addr, uint8_t value);
@@ -0,0 +1,196 @@
+// Prehrani zaznamu hran (edgetrace.h) - ze socedge.c na brane nebo z irloopback -t / -T.
+// Kanal IR dekoduje port prijmu bootloaderu (stranky firmware), kanal RF dekoder RH_ASK
+// a zpravy senzoru stejne jako socrf.c (sensormsg.c). Vypise prijate ramce a rychlost prehravani.
+//
+//   ./edgereplay ir.edg rf.edg
+//   nc gateway 9993 <<< "RF 60" > rf.edg; ./edgereplay rf.edg
+//   ./edgereplay -x rf.edg | nc gateway 9994
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "edgetrace.h"
+#include "pllrx.h"
+#include "sensormsg.h"
+#include "irframe.h"
+
+typedef struct {
+    int quiet;
+    int hex;
+    uint32_t ok, bad;
+} replay_t;
+
+static void print_rf_frame(const uint8_t *frame, size_t len) {
+    uint8_t payload[SENSORMSG_MAX_LEN];
+    size_t payload_len;
+    const uint8_t *data = sensormsg_unframe(frame, len, &payload_len);
+    sensormsg_t msg;
+
+    if (!data || payload_len > sizeof(payload)) {
+        printf("neznamy ramec %zu B\n", len);
+        return;
+    }
+    memcpy(payload, data, payload_len);
+
+    switch (sensormsg_decode(payload, payload_len, &msg)) {
+        case SENSORMSG_REPORT:
+            printf("hlaseni senzor %u msg %u flags 0x%02X vcc %u humitemp 0x%08X\n",
+                   msg.report.sensor_id, msg.report.msg_id, msg.report.flags, msg.report.vcc,
+                   (unsigned)msg.report.humitemp);
+            break;
+        case SENSORMSG_TELEMETRY:
+            printf("telemetrie senzor %u msg %u stack %u aktivni %u/%u/%u ms\n",
+                   msg.telemetry.sensor_id, msg.telemetry.msg_id, msg.telemetry.stack_free,
+                   msg.telemetry.am2302_ms, msg.telemetry.rf_ms, msg.telemetry.ir_ms);
+            break;
+        case SENSORMSG_ALERT:
+            printf("poplach senzor %u msg %u flags 0x%02X\n", msg.alert.sensor_id, msg.alert.msg_id, msg.alert.flags);
+            break;
+        case SENSORMSG_BEACON:
+            printf("beacon bootloaderu senzor %u%s\n", msg.beacon.sensor_id, msg.beacon.nrz ? ", umi NRZ" : "");
+            break;
+        default:
+            printf("neplatna zprava %zu B\n", payload_len);
+            break;
+    }
+}
+
+static void frame_received(void *ctx, const uint8_t *frame, size_t len, bool crc_ok, uint64_t t_ns) {
+    replay_t *r = ctx;
+
+    if (crc_ok) r->ok++;
+    else r->bad++;
+
+    if (r->hex) {
+        // radek pro port RF brany (socrf.c) nebo rfhub - jako by byl zaznam z prijimace
+        if (!crc_ok || len == IRFRAME_FRAME_LEN) return;
+        for (size_t i = 0; i < len; i++) printf("%02X", frame[i]);
+        printf("\n");
+        return;
+    }
+    if (r->quiet) return;
+
+    printf("%10.3f ms  ", t_ns / 1e6);
+    if (!crc_ok) {
+        printf("chybne CRC (%zu B)\n", len);
+    } else if (len == IRFRAME_FRAME_LEN) {
+        // ramec stranky bez START symbolu: ZH, ZL, index, data, CRC
+        printf("stranka 0x%04X index %u\n", frame[0] << 8 | frame[1], frame[2]);
+    } else {
+        print_rf_frame(frame, len);
+    }
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *buf = malloc(size > 0 ? size : 1);
+    if (buf && fread(buf, 1, size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = size;
+    return buf;
+}
+
+static int replay(const char *path, uint32_t bit_rate, int quiet, int hex) {
+    size_t len;
+    uint8_t *buf = read_file(path, &len);
+    edgetrace_header_t header;
+
+    if (!buf) return -1;
+    if (edgetrace_read_header(buf, len, &header)) {
+        fprintf(stderr, "%s: neni zaznam edgetrace\n", path);
+        free(buf);
+        return -1;
+    }
+
+    replay_t r = {.quiet = quiet, .hex = hex};
+    static pllrx_t rx;
+    pllrx_init(&rx, header.channel == EDGETRACE_IR ? PLLRX_BOOTLOADER : PLLRX_RHASK, bit_rate, frame_received, &r);
+
+    edgetrace_reader_t reader;
+    edgetrace_reader_init(&reader, buf + EDGETRACE_HEADER_LEN, len - EDGETRACE_HEADER_LEN, header.first_level);
+
+    uint8_t level;
+    uint32_t ticks;
+    uint64_t spans = 0, breaks = 0;
+    edgetrace_item_t item;
+    clock_t host_start = clock();
+
+    while ((item = edgetrace_next(&reader, &level, &ticks)) != EDGETRACE_END) {
+        if (item == EDGETRACE_ERROR) {
+            fprintf(stderr, "%s: poskozeny zaznam za %llu useky\n", path, (unsigned long long)spans);
+            break;
+        }
+        if (item == EDGETRACE_BREAK) {
+            breaks++;
+            pllrx_reset(&rx);
+            continue;
+        }
+        spans++;
+        pllrx_feed(&rx, level, (uint64_t)ticks * 1000000000ULL / header.resolution_hz);
+    }
+
+    double host_s = (double)(clock() - host_start) / CLOCKS_PER_SEC;
+    double signal_s = rx.t_ns / 1e9;
+
+    if (hex) {
+        free(buf);
+        return 0;
+    }
+
+    printf("zaznam              : %s, kanal %s, %u Hz, %zu B\n", path,
+           header.channel == EDGETRACE_IR ? "IR" : "RF", (unsigned)header.resolution_hz, len);
+    printf("useky               : %llu (%llu preruseni), %.3f s signalu\n",
+           (unsigned long long)spans, (unsigned long long)breaks, signal_s);
+    printf("ramce               : %u OK, %u chybne CRC, %u neznamych symbolu, %u v NRZ\n", r.ok, r.bad,
+           rx.bad_symbols, rx.nrz_frames);
+    printf("prehrani            : %.3f s (%.0fx realny cas)\n", host_s, host_s > 0 ? signal_s / host_s : 0);
+
+    free(buf);
+    return 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "pouziti: %s [-s speed] [-q] [-x] zaznam.edg...\n"
+            "  -s  rychlost v bitech/s (vychozi 2000 - IR i RH_ASK)\n"
+            "  -q  jen souhrn, bez vypisu ramcu\n"
+            "  -x  jen ramce RF v hex po radcich - vstup pro port 9994 brany nebo rfhub\n", name);
+}
+
+int main(int argc, char **argv) {
+    uint32_t speed = 2000;
+    int quiet = 0, hex = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:qxh")) != -1) {
+        switch (opt) {
+            case 's': speed = atoi(optarg); break;
+            case 'q': quiet = 1; break;
+            case 'x': hex = 1; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc || !speed) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int rc = 0;
+    for (int i = optind; i < argc; i++) {
+        if (replay(argv[i], speed, quiet, hex)) rc = 1;
+    }
+    return rc;
+}
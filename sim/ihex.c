@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <string.h>
+#include "irframe.h"
+#include "ihex.h"
+
+// stejny parser jako na ESP32 (socirtx), jen cteni ze souboru
+int ihex_load(const char *path, uint8_t *mem, size_t memlen, size_t *end, uint8_t *used) {
+    FILE *f = fopen(path, "r");
+    static irframe_hex_t hex;
+    uint8_t buf[512];
+    size_t n;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    irframe_hex_init(&hex, mem, memlen);
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        if (irframe_hex_feed(&hex, buf, n) != IRFRAME_HEX_MORE) break;
+    }
+    fclose(f);
+
+    if (irframe_hex_finish(&hex) != IRFRAME_HEX_DONE) {
+        fprintf(stderr, "%s:%u: neplatny radek, checksum nebo adresa mimo pamet\n", path, (unsigned)hex.line_no);
+        return -1;
+    }
+    if (end) *end = hex.end;
+    if (used) memcpy(used, hex.used, sizeof(hex.used));
+    return 0;
+}
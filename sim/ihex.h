@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Nacte Intel HEX soubor do pameti 'mem' (nepouzite byty nemeni).
+// Vraci 0 pri uspechu, do 'end' ulozi nejvyssi zapsanou adresu + 1
+// a do 'used' (IRFRAME_PAGE_MAP_LEN bytu) bitmapu stranek se zaznamy.
+int ihex_load(const char *path, uint8_t *mem, size_t memlen, size_t *end, uint8_t *used);
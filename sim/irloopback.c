@@ -0,0 +1,383 @@
+// Loopback test celeho nahravani firmware bez hardware:
+// main.hex -> stranky (irframe.c z ESP32) -> bity RMT -> simulovany ATtiny84 s bootloader.hex -> SPM.
+// Na konci porovna flash s main.hex a vypise propustnost.
+//
+// Casovani vysilani odpovida RMT bytes encoderu v socirtx.c: kazdy bit 2x (1000000 / speed / 2) uS,
+// MSB first, bit 0 = nosna (IRM-3638T stahne vystup do 0). Kazda stranka je samostatne spojeni
+// na port socirtx - tedy vlastni preambule a START symbol.
+//
+// S -r ceka vysilac na RH_ASK beacon bootloaderu na PB0 (jako rollout na brane) misto pevne prodlevy,
+// -q simuluje skok z aplikace (r25:r24 = BOOTLOADER_QUICK) - bez uvodniho blikani.
+// -n vysila stranky v kodovani NRZ (START "FN") misto 4b6b - bootloader ho musi umet (beacon 'N').
+// -t / -T ulozi vysilany IR signal a zapisy PB0 (beacon) ve formatu edgetrace.h pro edgereplay.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "avrsim.h"
+#include "ihex.h"
+#include "irframe.h"
+#include "edgetrace.h"
+
+#define BOOTLOADER_START 0x1D00
+#define BOOTLOADER_QUICK 0xB007     // bootloader.S
+#define BEACON_BIT_US 500           // RH_ASK 2000 b/s
+#define BEACON_START 0xB38          // posledni dva symboly preambule RH_ASK
+#define MAX_PAGES (IRFRAME_FLASH_LIMIT / IRFRAME_PAGE_SIZE)
+
+typedef struct {
+    double start_us;                // zacatek vysilani vzhledem ke vstupu do bootloaderu
+    size_t len;
+    uint8_t data[IRFRAME_PAGE_TX_LEN];
+} tx_segment_t;
+
+typedef struct {
+    uint8_t level;                  // posledni zapsana uroven PB0
+    uint64_t last_cycle;
+    uint16_t bits;                  // poslednich 12 bitu, nejstarsi vpravo - jako RH_ASK
+    int active;
+    int bit_count;
+    uint8_t buf[8];
+    uint8_t len;
+    uint8_t crc;
+} beacon_rx_t;
+
+typedef struct {
+    FILE *f;
+    edgetrace_writer_t w;
+    uint64_t ticks;                 // konec zapsanych useku v us
+} trace_out_t;
+
+typedef struct {
+    tx_segment_t *segs;
+    size_t count;
+    size_t cur;                     // cas jde jen dopredu - pamatujeme si posledni segment
+    double bit_us;
+    double skew;                    // relativni odchylka hodin vysilace
+    double base_us;                 // zacatek vysilani, < 0 dokud neprisel beacon
+    double delay_us;                // prodleva po beaconu
+    uint64_t first_read_cycle;
+    beacon_rx_t beacon;
+    double beacon_us;               // konec beaconu, < 0 neprisel
+    int beacon_id;
+    int beacon_nrz;                 // beacon 'N' - bootloader umi NRZ
+    trace_out_t *rf_trace;
+} waveform_t;
+
+static double cycles_to_us(uint64_t cycles) {
+    return cycles * 1e6 / AVRSIM_F_CPU;
+}
+
+static uint8_t waveform_level(waveform_t *w, double t_us) {
+    if (w->base_us < 0) return 1;
+    t_us = (t_us - w->base_us) * (1.0 + w->skew);
+    while (w->cur < w->count) {
+        tx_segment_t *s = &w->segs[w->cur];
+        double end = s->start_us + s->len * 8 * w->bit_us;
+        if (t_us < s->start_us) return 1;     // klid - bez nosne (i pred zacatkem)
+        if (t_us < end) {
+            size_t bit = (size_t)((t_us - s->start_us) / w->bit_us);
+            return (s->data[bit / 8] >> (7 - bit % 8)) & 1;
+        }
+        w->cur++;
+    }
+    return 1;
+}
+
+static uint8_t pin_reader(void *ctx, char port, uint64_t cycle) {
+    waveform_t *w = ctx;
+    if (port != 'B') return 0;
+    if (!w->first_read_cycle) w->first_read_cycle = cycle;
+    return waveform_level(w, cycles_to_us(cycle)) << 2; // IR prijimac na PB2
+}
+
+static double segments_end_us(waveform_t *w) {
+    tx_segment_t *s = &w->segs[w->count - 1];
+    return s->start_us + s->len * 8 * w->bit_us;
+}
+
+static int trace_open(trace_out_t *t, const char *path, uint8_t channel, uint8_t first_level) {
+    uint8_t buf[EDGETRACE_HEADER_LEN];
+    edgetrace_header_t header = {
+        .channel = channel,
+        .first_level = first_level,
+        .resolution_hz = 1000000,
+        .time = (uint32_t)time(NULL),
+    };
+
+    t->f = fopen(path, "wb");
+    if (!t->f) {
+        perror(path);
+        return -1;
+    }
+    fwrite(buf, 1, edgetrace_write_header(&header, buf), t->f);
+    edgetrace_writer_init(&t->w, first_level);
+    t->ticks = 0;
+    return 0;
+}
+
+// usek s urovni level az do casu end_us
+static void trace_span(trace_out_t *t, uint8_t level, double end_us) {
+    uint8_t buf[2 * EDGETRACE_MAX_ITEM_LEN];
+    uint64_t end = (uint64_t)(end_us + 0.5);
+    if (!t || !t->f || end <= t->ticks) return;
+    fwrite(buf, 1, edgetrace_writer_add(&t->w, level, end - t->ticks, buf), t->f);
+    t->ticks = end;
+}
+
+static void trace_close(trace_out_t *t) {
+    uint8_t buf[EDGETRACE_MAX_ITEM_LEN];
+    if (!t->f) return;
+    fwrite(buf, 1, edgetrace_writer_flush(&t->w, buf), t->f);
+    fclose(t->f);
+    t->f = NULL;
+}
+
+// vysilany IR signal - stejne jako waveform_level, vcetne odchylky hodin
+static void trace_waveform(trace_out_t *t, waveform_t *w, double end_us) {
+    double scale = 1.0 / (1.0 + w->skew);
+    if (w->base_us >= 0) {
+        for (size_t i = 0; i < w->count; i++) {
+            tx_segment_t *s = &w->segs[i];
+            for (size_t bit = 0; bit < s->len * 8; bit++) {
+                double start = w->base_us + (s->start_us + bit * w->bit_us) * scale;
+                if (start >= end_us) goto idle;
+                trace_span(t, 1, start);
+                trace_span(t, (s->data[bit / 8] >> (7 - bit % 8)) & 1, start + w->bit_us * scale);
+            }
+        }
+    }
+idle:
+    trace_span(t, 1, end_us);
+}
+
+static uint8_t symbol_6to4(uint8_t symbol) {
+    static const uint8_t symbols[16] = {0x0d, 0x0e, 0x13, 0x15, 0x16, 0x19, 0x1a, 0x1c,
+                                        0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34};
+    for (uint8_t i = 0; i < 16; i++) {
+        if (symbols[i] == symbol) return i;
+    }
+    return 0;
+}
+
+static void beacon_bit(waveform_t *w, uint8_t bit, double t_us) {
+    beacon_rx_t *b = &w->beacon;
+
+    b->bits = b->bits >> 1 | (uint16_t)bit << 11;
+    if (!b->active) {
+        if (b->bits == BEACON_START) {
+            b->active = 1;
+            b->bit_count = 0;
+            b->len = 0;
+            b->crc = 0;
+        }
+        return;
+    }
+    if (++b->bit_count < 12) return;
+    b->bit_count = 0;
+
+    uint8_t byte = symbol_6to4(b->bits & 0x3f) << 4 | symbol_6to4(b->bits >> 6);
+    b->crc = irframe_crc8(b->crc, byte);
+    b->buf[b->len++] = byte;
+    if (b->buf[0] < 3 || b->buf[0] > sizeof(b->buf)) {
+        b->active = 0;
+        return;
+    }
+    if (b->len < b->buf[0]) return;
+
+    b->active = 0;
+    if (b->crc || (b->buf[1] != 'R' && b->buf[1] != 'N') || w->beacon_us >= 0) return;
+    w->beacon_us = t_us;
+    w->beacon_id = b->buf[2];
+    w->beacon_nrz = b->buf[1] == 'N';
+    if (w->base_us < 0) w->base_us = t_us + w->delay_us;
+}
+
+// bootloader zapisuje PB0 jednou za bit - pocet bitu urcuje cas od posledniho zapisu
+static void port_writer(void *ctx, uint8_t io_addr, uint8_t value, uint64_t cycle) {
+    waveform_t *w = ctx;
+    beacon_rx_t *b = &w->beacon;
+    if (io_addr != AVRSIM_IO_PORTB) return;
+
+    double t_us = cycles_to_us(cycle);
+    trace_span(w->rf_trace, b->level, t_us);
+    int n = (int)((t_us - cycles_to_us(b->last_cycle)) / BEACON_BIT_US + 0.5);
+    if (n > 32) n = 32;                 // dlouhy klid - staci vyplnit posuvny registr
+    for (int i = 0; i < n; i++) beacon_bit(w, b->level, t_us);
+    if (n) b->last_cycle = cycle;
+    b->level = value & 1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "pouziti: %s [-b bootloader.hex] [-m main.hex] [-s speed] [-d delay_ms] [-g gap_ms] [-p ppm] [-q] [-r] [-n] [-t ir.edg] [-T rf.edg]\n"
+            "  -s  rychlost IR v bitech/s (jako irtx_socket_writer_init, vychozi 2000)\n"
+            "  -d  zacatek vysilani po vstupu do bootloaderu (vychozi 6000 - 'sleep 6' v deploy),\n"
+            "      s -r po prijmu beaconu (vychozi 0)\n"
+            "  -q  vstup skokem z aplikace (jmp_to_bootloader(BOOTLOADER_QUICK)) - bez blikani\n"
+            "  -r  vysilat az po beaconu bootloaderu na PB0 (jako rollout)\n"
+            "  -n  stranky v kodovani NRZ se skramblerem misto 4b6b\n"
+            "  -g  mezera mezi strankami - navazani spojeni na ESP32 (vychozi 0)\n"
+            "  -p  odchylka hodin vysilace v ppm\n"
+            "  -t  ulozit vysilany IR signal (edgetrace.h, pro edgereplay)\n"
+            "  -T  ulozit vystup PB0 - beacon na 433 MHz\n", name);
+}
+
+int main(int argc, char **argv) {
+    const char *bootloader_path = "../bootloader/bootloader.hex";
+    const char *main_path = "../example/motionrx/main.hex";
+    int speed = 2000;
+    double delay_ms = -1, gap_ms = 0, ppm = 0;
+    const char *ir_trace_path = NULL, *rf_trace_path = NULL;
+    int quick = 0, wait_beacon = 0;
+    irframe_code_t code = IRFRAME_CODE_4B6B;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:m:s:d:g:p:qrnt:T:h")) != -1) {
+        switch (opt) {
+            case 'b': bootloader_path = optarg; break;
+            case 'm': main_path = optarg; break;
+            case 's': speed = atoi(optarg); break;
+            case 'd': delay_ms = atof(optarg); break;
+            case 'g': gap_ms = atof(optarg); break;
+            case 'p': ppm = atof(optarg); break;
+            case 'q': quick = 1; break;
+            case 'r': wait_beacon = 1; break;
+            case 'n': code = IRFRAME_CODE_NRZ; break;
+            case 't': ir_trace_path = optarg; break;
+            case 'T': rf_trace_path = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (delay_ms < 0) delay_ms = wait_beacon ? 0 : 6000;
+
+    static avrsim_t sim;
+    avrsim_init(&sim);
+    // ve flash zustal stary program - stranky, ktere neposleme, nesmi byt 0xFF, jinak by overeni
+    // neodhalilo vynechanou stranku, kterou HEX vyplnil 0xFF
+    for (size_t i = 0; i < IRFRAME_FLASH_LIMIT; i++) sim.flash[i] = 0x5A ^ i;
+    if (ihex_load(bootloader_path, sim.flash, sizeof(sim.flash), NULL, NULL)) return 2;
+
+    static uint8_t image[IRFRAME_FLASH_LIMIT];
+    uint8_t used[IRFRAME_PAGE_MAP_LEN];
+    size_t image_end = 0;
+    memset(image, 0xFF, sizeof(image));
+    if (ihex_load(main_path, image, sizeof(image), &image_end, used)) return 2;
+    if (!image_end) {
+        fprintf(stderr, "%s: prazdny obraz\n", main_path);
+        return 2;
+    }
+
+    // stranky posilame vzestupne, index klesa k 1 - bootloader po posledni skoci na 0
+    // stranky mimo HEX vynechame stejne jako irtx_send_image
+    size_t pages = (image_end + IRFRAME_PAGE_SIZE - 1) / IRFRAME_PAGE_SIZE;
+    size_t sent = irframe_pages_to_send(used, image_end);
+    static tx_segment_t segs[MAX_PAGES];
+    waveform_t wave = {
+        .segs = segs,
+        .count = sent,
+        .bit_us = 2 * (1000000 / speed / 2),
+        .skew = ppm / 1e6,
+        .base_us = wait_beacon ? -1 : delay_ms * 1000,
+        .delay_us = delay_ms * 1000,
+        .beacon_us = -1,
+    };
+
+    double t = 0;
+    size_t s = 0;
+    for (size_t p = 0; p < pages; p++) {
+        if (!irframe_page_used(used, p)) continue;
+        segs[s].start_us = t;
+        segs[s].len = irframe_encode_page(p * IRFRAME_PAGE_SIZE, sent - s, image + p * IRFRAME_PAGE_SIZE, code,
+                                          segs[s].data, sizeof(segs[s].data));
+        t += segs[s].len * 8 * wave.bit_us + gap_ms * 1000;
+        s++;
+    }
+
+    static trace_out_t rf_trace;
+    if (rf_trace_path) {
+        if (trace_open(&rf_trace, rf_trace_path, EDGETRACE_RF, 0)) return 2;
+        wave.rf_trace = &rf_trace;
+    }
+
+    sim.pin_reader = pin_reader;
+    sim.port_writer = port_writer;
+    sim.ctx = &wave;
+
+    if (quick) {
+        sim.data[24] = BOOTLOADER_QUICK & 0xFF;
+        sim.data[25] = BOOTLOADER_QUICK >> 8;
+    }
+
+    // bez beaconu se ceka nejdele jako 'sleep 6'
+    uint64_t timeout = (uint64_t)((segments_end_us(&wave) + (wait_beacon ? 6e6 : delay_ms * 1000) + 2e6) *
+                                  AVRSIM_F_CPU / 1e6);
+    int finished = 0, failed = 0;
+    clock_t host_start = clock();
+
+    // reset vektor bootloaderu skace na start (jako jmp_to_bootloader)
+    while (sim.cycles < timeout) {
+        avrsim_status_t st = avrsim_step(&sim);
+        if (st == AVRSIM_BAD_OPCODE) {
+            fprintf(stderr, "neznama instrukce 0x%04X na 0x%04X\n",
+                    sim.flash[sim.pc * 2] | sim.flash[sim.pc * 2 + 1] << 8, sim.pc * 2);
+            return 2;
+        }
+        if (sim.pc == 0 && sim.cycles > 2) {
+            finished = 1;   // bootloader_finished_properly - ijmp na 0
+            break;
+        }
+        if ((sim.data[0x20 + AVRSIM_IO_WDTCSR] & 0x18) == 0x08) { // WDE bez WDCE
+            failed = 1;     // failed: - program smazan, ceka na reset od watchdogu
+            break;
+        }
+    }
+
+    double host_s = (double)(clock() - host_start) / CLOCKS_PER_SEC;
+    double sim_us = cycles_to_us(sim.cycles);
+    double upload_s = (sim_us - wave.base_us - segs[0].start_us) / 1e6;
+
+    if (rf_trace_path) {
+        trace_span(&rf_trace, wave.beacon.level, sim_us);
+        trace_close(&rf_trace);
+    }
+    if (ir_trace_path) {
+        trace_out_t ir_trace = {0};
+        if (trace_open(&ir_trace, ir_trace_path, EDGETRACE_IR, 1)) return 2;
+        trace_waveform(&ir_trace, &wave, sim_us);
+        trace_close(&ir_trace);
+    }
+
+    // stranky mimo HEX si smi nechat stary obsah
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pages * IRFRAME_PAGE_SIZE; i++) {
+        if (irframe_page_used(used, i / IRFRAME_PAGE_SIZE) && sim.flash[i] != image[i]) mismatches++;
+    }
+
+    printf("obraz               : %s, %zu B, %zu stranek (%zu mimo HEX vynechano)\n",
+           main_path, image_end, pages, pages - sent);
+    printf("IR rychlost         : %d b/s, %zu B na stranku vcetne preambule (%s)\n", speed, segs[0].len,
+           code == IRFRAME_CODE_NRZ ? "NRZ" : "4b6b");
+    if (wave.first_read_cycle)
+        printf("bootloader pripraven: %.1f ms po vstupu\n", cycles_to_us(wave.first_read_cycle) / 1000);
+    if (wave.beacon_us >= 0)
+        printf("beacon              : senzor %d, %.1f ms po vstupu%s\n", wave.beacon_id, wave.beacon_us / 1000,
+               wave.beacon_nrz ? ", umi NRZ" : "");
+    else
+        printf("beacon              : neprisel\n");
+    printf("vysledek            : %s\n", finished ? "bootloader skocil do programu" :
+                                       failed ? "bootloader selhal (failed)" : "timeout");
+    printf("SPM                 : %u mazani, %u zapisu\n", sim.spm_erases, sim.spm_writes);
+    printf("overeni flash       : %s (%zu rozdilnych bytu)\n", mismatches ? "CHYBA" : "OK", mismatches);
+    if (finished) {
+        printf("nahravani           : %.3f s od prvniho bitu, %.3f s od vstupu\n", upload_s, sim_us / 1e6);
+        printf("propustnost         : %.3f s/KB, %.2f stranek/s, %.1f B/s\n",
+               upload_s * 1024 / image_end, sent / upload_s, image_end / upload_s);
+    }
+    printf("simulace            : %.2f s simulovaneho casu za %.2f s (%.0fx realny cas)\n",
+           sim_us / 1e6, host_s, host_s > 0 ? sim_us / 1e6 / host_s : 0);
+
+    return finished && !mismatches ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+// Stojan za port RF brany (socrf.c) na hostu - prijimace se pripoji pres TCP a posilaji
+// demodulovane ramce jako radky hex znaku, volitelne s uvodnim "RX <jmeno>". Kopie z vice
+// prijimacu slouci rffusion.c stejne jako brana, vypise se jen prvni kopie kazde zpravy
+// a na konci statistika po prijimacich.
+//
+//   ./rfhub -p 9994 &
+//   ./edgereplay -x rf.edg | (echo "RX sever"; cat) | nc -q0 localhost 9994
+//   ./edgereplay -x rf.edg | (echo "RX jih"; cat) | nc -q0 localhost 9994
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include "rffusion.h"
+#include "sensormsg.h"
+
+#define HUB_LINE_LEN (2 * (SENSORMSG_MAX_LEN + 2) + 32)
+
+typedef struct {
+    int sock;
+    int receiver;
+    size_t len;
+    char line[HUB_LINE_LEN];
+} hub_conn_t;
+
+typedef struct {
+    rffusion_t fusion;
+    hub_conn_t conns[RFFUSION_RECEIVERS];
+    int quiet;
+    uint32_t errors;
+} hub_t;
+
+static volatile sig_atomic_t _stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    _stop = 1;
+}
+
+static uint32_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void hub_error(hub_t *hub, hub_conn_t *c) {
+    rffusion_error(&hub->fusion, c->receiver);
+    hub->errors++;
+}
+
+static void hub_frame(hub_t *hub, hub_conn_t *c, const uint8_t *frame, size_t len) {
+    uint8_t payload[SENSORMSG_MAX_LEN];
+    size_t payload_len;
+    sensormsg_t msg;
+
+    const uint8_t *data = sensormsg_unframe(frame, len, &payload_len);
+    if (!data || payload_len > sizeof(payload)) {
+        hub_error(hub, c);
+        return;
+    }
+    memcpy(payload, data, payload_len);
+
+    sensormsg_type_t type = sensormsg_decode(payload, payload_len, &msg);
+    if (type == SENSORMSG_INVALID) {
+        hub_error(hub, c);
+        return;
+    }
+
+    const char *name = c->receiver >= 0 ? hub->fusion.receivers[c->receiver].name : "?";
+    uint32_t key;
+    switch (type) {
+        case SENSORMSG_REPORT:
+            key = rffusion_key(msg.report.sensor_id, msg.report.msg_id, RFFUSION_KIND_MESSAGE);
+            break;
+        case SENSORMSG_TELEMETRY:
+            key = rffusion_key(msg.telemetry.sensor_id, msg.telemetry.msg_id, RFFUSION_KIND_MESSAGE);
+            break;
+        case SENSORMSG_ALERT:
+            key = rffusion_key(msg.alert.sensor_id, msg.alert.msg_id, RFFUSION_KIND_ALERT);
+            break;
+        default:
+            rffusion_count(&hub->fusion, c->receiver, now_ms());
+            if (!hub->quiet) printf("%-16s beacon bootloaderu senzor %u\n", name, msg.beacon.sensor_id);
+            return;
+    }
+
+    if (!rffusion_accept(&hub->fusion, c->receiver, key, now_ms()) || hub->quiet) return;
+
+    if (type == SENSORMSG_REPORT) {
+        printf("%-16s hlaseni senzor %u msg %u flags 0x%02X vcc %u\n", name,
+               msg.report.sensor_id, msg.report.msg_id, msg.report.flags, msg.report.vcc);
+    } else if (type == SENSORMSG_TELEMETRY) {
+        printf("%-16s telemetrie senzor %u msg %u\n", name, msg.telemetry.sensor_id, msg.telemetry.msg_id);
+    } else {
+        printf("%-16s poplach senzor %u msg %u flags 0x%02X\n", name,
+               msg.alert.sensor_id, msg.alert.msg_id, msg.alert.flags);
+    }
+    fflush(stdout);
+}
+
+static void hub_line(hub_t *hub, hub_conn_t *c, char *line) {
+    uint8_t frame[SENSORMSG_MAX_LEN + 2];
+
+    if (!line[0]) return;
+    if (!strncmp(line, "RX ", 3)) {
+        c->receiver = rffusion_rename(&hub->fusion, c->receiver, line + 3);
+        return;
+    }
+
+    int len = sensormsg_parse_hex(line, frame, sizeof(frame));
+    if (len < 0) {
+        hub_error(hub, c);
+        return;
+    }
+    hub_frame(hub, c, frame, len);
+}
+
+// vraci -1 po uzavreni spojeni
+static int hub_read(hub_t *hub, hub_conn_t *c) {
+    ssize_t n = recv(c->sock, c->line + c->len, sizeof(c->line) - 1 - c->len, 0);
+    if (n <= 0) return -1;
+    c->len += n;
+
+    char *start = c->line, *end;
+    while ((end = memchr(start, '\n', c->line + c->len - start))) {
+        *end = 0;
+        if (end > start && end[-1] == '\r') end[-1] = 0;
+        hub_line(hub, c, start);
+        start = end + 1;
+    }
+    c->len -= start - c->line;
+    memmove(c->line, start, c->len);
+
+    if (c->len == sizeof(c->line) - 1) {
+        c->len = 0;
+        hub_error(hub, c);
+    }
+    return 0;
+}
+
+static int hub_listen(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(port),
+    };
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, RFFUSION_RECEIVERS) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void hub_accept(hub_t *hub, int server_fd) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    char name[RFFUSION_NAME_LEN];
+    int sock = accept(server_fd, (struct sockaddr *)&addr, &addr_len);
+
+    if (sock < 0) return;
+    for (int i = 0; i < RFFUSION_RECEIVERS; i++) {
+        hub_conn_t *c = &hub->conns[i];
+        if (c->sock >= 0) continue;
+
+        // na hostu bezi prijimace casto z jedne adresy - jmeno i s portem
+        snprintf(name, sizeof(name), "%s:%u", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+        c->sock = sock;
+        c->len = 0;
+        c->receiver = rffusion_receiver(&hub->fusion, name);
+        if (c->receiver >= 0) return;
+        c->sock = -1;
+        break;
+    }
+    fprintf(stderr, "prilis mnoho prijimacu\n");
+    close(sock);
+}
+
+static void print_stats(const hub_t *hub) {
+    const rffusion_t *f = &hub->fusion;
+
+    printf("zpravy              : %u jedinecnych, %u kopii, %u vytlaceno z okna, %u chyb\n",
+           f->unique, f->duplicates, f->evicted, hub->errors);
+    printf("%-24s %8s %8s %8s %8s %7s\n", "prijimac", "ramce", "prvni", "kopie", "chyby", "prinos");
+    for (int i = 0; i < RFFUSION_RECEIVERS; i++) {
+        const rffusion_receiver_t *r = &f->receivers[i];
+        if (!r->used) continue;
+        // prinos - podil jedinecnych zprav, ktere prisly nejdriv od tohoto prijimace
+        printf("%-24s %8u %8u %8u %8u %6.1f%%\n", r->name, r->frames, r->first, r->duplicates, r->errors,
+               f->unique ? 100.0 * r->first / f->unique : 0.0);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "pouziti: %s [-p port] [-w okno_ms] [-e] [-q]\n"
+            "  -p  port (vychozi 9994 jako brana)\n"
+            "  -w  jak dlouho se pamatuje prijata zprava (vychozi %u ms)\n"
+            "  -e  skoncit po odpojeni posledniho prijimace\n"
+            "  -q  jen souhrn, bez vypisu zprav\n", name, RFFUSION_WINDOW_MS);
+}
+
+int main(int argc, char **argv) {
+    static hub_t hub;
+    int port = 9994, exit_idle = 0, opt;
+    uint32_t window_ms = RFFUSION_WINDOW_MS;
+
+    while ((opt = getopt(argc, argv, "p:w:eqh")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'w': window_ms = atoi(optarg); break;
+            case 'e': exit_idle = 1; break;
+            case 'q': hub.quiet = 1; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    rffusion_init(&hub.fusion, window_ms);
+    for (int i = 0; i < RFFUSION_RECEIVERS; i++) hub.conns[i].sock = -1;
+
+    int server_fd = hub_listen(port);
+    if (server_fd < 0) return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int served = 0;
+    while (!_stop) {
+        fd_set fds;
+        int max_fd = server_fd, open_conns = 0;
+
+        FD_ZERO(&fds);
+        FD_SET(server_fd, &fds);
+        for (int i = 0; i < RFFUSION_RECEIVERS; i++) {
+            if (hub.conns[i].sock < 0) continue;
+            FD_SET(hub.conns[i].sock, &fds);
+            if (hub.conns[i].sock > max_fd) max_fd = hub.conns[i].sock;
+            open_conns++;
+        }
+        if (exit_idle && served && !open_conns) break;
+
+        if (select(max_fd + 1, &fds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) continue;
+            perror("select");
+            break;
+        }
+
+        for (int i = 0; i < RFFUSION_RECEIVERS; i++) {
+            hub_conn_t *c = &hub.conns[i];
+            if (c->sock < 0 || !FD_ISSET(c->sock, &fds) || !hub_read(&hub, c)) continue;
+            rffusion_disconnect(&hub.fusion, c->receiver);
+            close(c->sock);
+            c->sock = -1;
+        }
+
+        if (FD_ISSET(server_fd, &fds)) {
+            hub_accept(&hub, server_fd);
+            served = 1;
+        }
+    }
+
+    close(server_fd);
+    print_stats(&hub);
+    return 0;
+}
@@ -0,0 +1,744 @@
+// Generator zateze RF brany - N virtualnich senzoru (example/motionrx) na spolecnem kanalu 433 MHz.
+//
+// Kazdy senzor se chova jako main.c: heartbeat po settings.ticks_message_wait probuzenich WDT (8 s),
+// pohyb PIR ve shlucich, poplach hned po probuzeni, hlaseni (message_t, SPECK CTR) dvakrat po 400 ms,
+// volitelne telemetrie po N-tem heartbeatu. Probuzeni behem vysilani se ztrati stejne jako na senzoru
+// (flags = 0 na konci smycky). Ramce jsou kodovane jako sender.S (4b6b nebo NRZ) vcetne odchylky
+// RC oscilatoru kazdeho kusu.
+//
+// Prijimac vidi OR nosnych vsech vysilacu, ktere slysi - kolize se neodpusti (bez capture efektu,
+// tedy pesimisticky). Signal kazdeho prijimace dekoduje pllrx.c, zpravy sensormsg.c a kopie
+// z prijimacu slouci rffusion.c jako socrf.c. Pro kazde N z -n vypise dekodovane ramce/s,
+// ztraty zprav a percentily zpozdeni od probuzeni senzoru do prvni kopie na brane.
+//
+//   ./rfload -n 10,50,100,200 -t 3600
+//   ./rfload -n 100 -r 3 -l 70 -c nrz
+//   ./rfload -n 50 -t 600 -T rf.edg && ./edgereplay rf.edg
+//   ./rfload -n 50 -x | ncat esp 9994           # ramce prvniho prijimace pro branu nebo rfhub
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+#include "edgetrace.h"
+#include "pllrx.h"
+#include "rffusion.h"
+#include "sensormsg.h"
+#include "irframe.h"
+
+#define MAX_SENSORS         254         // 0xFF je broadcast / RF_SENSOR_ANY
+#define MAX_RUNS            16
+#define MAX_RECEIVERS       16          // bity masky tx_t.heard, nejvyse RFFUSION_RECEIVERS
+
+#define BIT_NS              500000.0    // RH_ASK 2000 b/s - TIMER_WRITE_HALF_NTICKS v sender.S
+#define MAX_TX_BITS         (8 * 6 + (SENSORMSG_MAX_LEN + 2) * 12)
+#define WDT_NS              8e9         // WDP3 | WDP0 v main.S
+#define WDT_TOLERANCE       0.1         // oscilator WDT 128 kHz - rozptyl mezi kusy
+
+// casy z main.c pri presnych hodinach
+#define KEYSTREAM_BLOCK_NS  160e3       // speck_ctr_keystream - jeden blok
+#define SENSOR_WAIT_NS      200e6       // delay_ms_200 pred merenim
+#define MEASURE_NS          25e6        // readVcc 2 ms + am2302_read (18 ms start + data)
+#define COPY_GAP_NS         400e6       // rf_send_twice - mezi kopiemi
+#define SEND_TAIL_NS        200e6       // rf_send_twice - po druhe kopii
+
+// shluk pohybu - PIR (AM312) drzi vystup ~2 s, clovek v mistnosti ho spousti znovu
+#define BURST_TRIGGERS_MEAN 3.0
+#define BURST_GAP_MIN_NS    2e9
+#define BURST_GAP_MAX_NS    8e9
+
+#define FW_VERSION          0xBC
+#define FLAG_PIR            (1 << 1)
+#define FLAG_WDT            (1 << 3)
+
+#define TAIL_NS             100000000ULL    // klid po poslednim vysilani - pllrx dokonci ramec
+
+typedef struct {
+    uint64_t s;
+} rng_t;
+
+typedef struct {
+    uint32_t key;               // rffusion_key
+    sensormsg_type_t type;
+    uint64_t wake_ns;           // probuzeni senzoru, ktere zpravu vyvolalo
+    uint64_t delivered_ns;      // prvni kopie za rffusion, 0 - nedorucena
+} message_t;
+
+typedef struct {
+    uint64_t start_ns;          // volani rf_send
+    double bit_ns;
+    uint16_t nbits;
+    uint8_t bits[(MAX_TX_BITS + 7) / 8];    // nejnizsi bit prvni
+    uint16_t heard;             // maska prijimacu, ktere ramec slysi
+} tx_t;
+
+typedef struct {
+    uint64_t t_ns;
+    int32_t delta;              // +1 nabezna hrana nosne, -1 sestupna
+} edge_t;
+
+typedef struct {
+    uint64_t t_ns;
+    uint32_t key;
+    int receiver;
+    uint32_t order;             // stejny cas z vice prijimacu - kdo prvni, rozhodne sit, tady nahoda
+} decoded_t;
+
+typedef struct {
+    uint8_t id;
+    rng_t rng;
+    rng_t link;                 // dosah a ztraty ramcu - provoz senzoru na poctu prijimacu nezavisi
+    double clock;               // delka casu senzoru vuci nominalni (RC oscilator)
+    double wdt_ns;
+    uint16_t heard;             // prijimace v dosahu
+    uint32_t msg_ctr;           // 24bit citac zprav, dolnich 16 bitu je msg_id
+    uint32_t tick;
+    uint8_t countdown;          // heartbeat_countdown
+    uint8_t telemetry_countdown;
+    uint16_t wake_wdt, wake_pir;
+    uint64_t busy_until_ns;
+} vsensor_t;
+
+typedef struct {
+    // parametry
+    uint32_t seed;
+    double duration_ns;
+    uint8_t ticks_message_wait;
+    uint8_t telemetry_every;
+    double motion_per_hour;
+    int nrz;
+    int receivers;
+    double coverage;            // pravdepodobnost, ze prijimac slysi senzor
+    double frame_loss;          // ztrata jednoho ramce na jednom prijimaci (unik, ruseni)
+    double clock_tolerance;
+    const char *trace_path;
+    int hex;
+
+    // vysledek generovani
+    message_t *msgs;
+    size_t msg_count, msg_cap;
+    tx_t *txs;
+    size_t tx_count, tx_cap;
+    double airtime_ns;
+    uint32_t lost_wakes;        // probuzeni behem vysilani - senzor je zahodi
+
+    // dekodovani
+    decoded_t *decoded;
+    size_t decoded_count, decoded_cap;
+    rffusion_t fusion;
+    rng_t rng;
+    int receiver;               // prave dekodovany prijimac
+    uint32_t frames_ok, crc_errors, invalid;
+} load_t;
+
+typedef struct {
+    FILE *f;
+    edgetrace_writer_t w;
+    uint64_t ticks;             // konec zapsanych useku v us
+} trace_out_t;
+
+static const uint8_t symbols[16] = {
+    0x0d, 0x0e, 0x13, 0x15, 0x16, 0x19, 0x1a, 0x1c,
+    0x23, 0x25, 0x26, 0x29, 0x2a, 0x2c, 0x32, 0x34,
+};
+
+// splitmix64 - stejna posloupnost na kazdem hostu, senzor i ma pri kazdem N stejny provoz
+static uint64_t rng_next(rng_t *r) {
+    uint64_t z = (r->s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(rng_t *r) {
+    return (rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_range(rng_t *r, double lo, double hi) {
+    return lo + (hi - lo) * rng_unit(r);
+}
+
+static double rng_exp(rng_t *r, double mean) {
+    return -mean * log1p(-rng_unit(r));
+}
+
+static void *grow(void *p, size_t *cap, size_t count, size_t size) {
+    if (count < *cap) return p;
+    *cap = *cap ? *cap * 2 : 1024;
+    p = realloc(p, *cap * size);
+    if (!p) {
+        fprintf(stderr, "nedostatek pameti\n");
+        exit(1);
+    }
+    return p;
+}
+
+static size_t put_bits(uint8_t *bits, size_t n, uint8_t value, int count) {
+    for (int i = 0; i < count; i++, n++) {
+        if (value >> i & 1) bits[n / 8] |= 1 << n % 8;
+    }
+    return n;
+}
+
+// bity vysilani jako rf_send v sender.S - kazdy symbol nejnizsim bitem napred
+static size_t rf_encode(const uint8_t *frame, size_t len, int nrz, uint8_t *bits) {
+    uint8_t scrambler = IRFRAME_SCRAMBLER_SEED;
+    size_t n = 0;
+
+    memset(bits, 0, (MAX_TX_BITS + 7) / 8);
+    for (int i = 0; i < 6; i++) n = put_bits(bits, n, 0x2a, 6);
+    n = put_bits(bits, n, 0x38, 6);
+    n = put_bits(bits, n, nrz ? 0x23 : 0x2c, 6);
+
+    for (size_t i = 0; i < len; i++) {
+        if (nrz) {
+            n = put_bits(bits, n, frame[i] ^ irframe_scrambler_next(&scrambler, 1), 8);
+        } else {
+            n = put_bits(bits, n, symbols[frame[i] >> 4], 6);
+            n = put_bits(bits, n, symbols[frame[i] & 0x0F], 6);
+        }
+    }
+    return n;
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v);
+    put_le16(p + 2, v >> 16);
+}
+
+static void add_message(load_t *l, vsensor_t *s, uint16_t msg_id, sensormsg_type_t type, uint64_t wake_ns) {
+    l->msgs = grow(l->msgs, &l->msg_cap, l->msg_count, sizeof(message_t));
+    l->msgs[l->msg_count++] = (message_t){
+        .key = rffusion_key(s->id, msg_id, type == SENSORMSG_ALERT ? RFFUSION_KIND_ALERT : RFFUSION_KIND_MESSAGE),
+        .type = type,
+        .wake_ns = wake_ns,
+    };
+}
+
+// jedno volani rf_send v case t_ns, vraci konec vysilani
+static double send_frame(load_t *l, vsensor_t *s, const uint8_t *payload, size_t len, double t_ns) {
+    uint8_t frame[SENSORMSG_MAX_LEN + 2];
+    size_t frame_len = sensormsg_frame(payload, len, frame);
+
+    l->txs = grow(l->txs, &l->tx_cap, l->tx_count, sizeof(tx_t));
+    tx_t *tx = &l->txs[l->tx_count++];
+    tx->start_ns = (uint64_t)t_ns;
+    tx->bit_ns = BIT_NS * s->clock;
+    tx->nbits = rf_encode(frame, frame_len, l->nrz, tx->bits);
+    tx->heard = 0;
+    for (int r = 0; r < l->receivers; r++) {
+        if (s->heard & 1 << r && rng_unit(&s->link) >= l->frame_loss) tx->heard |= 1 << r;
+    }
+
+    // uvodni cekani, bity a cekani na dokonceni posledniho bitu
+    double airtime = (tx->nbits + 2) * tx->bit_ns;
+    l->airtime_ns += tx->nbits * tx->bit_ns;
+    return t_ns + airtime;
+}
+
+// rf_send_twice - vraci konec po delay_ms_200 za druhou kopii
+static double send_twice(load_t *l, vsensor_t *s, const uint8_t *payload, size_t len, double t_ns) {
+    t_ns = send_frame(l, s, payload, len, t_ns) + COPY_GAP_NS * s->clock;
+    return send_frame(l, s, payload, len, t_ns) + SEND_TAIL_NS * s->clock;
+}
+
+static void ctr_header(uint8_t *payload, uint8_t sensor_id, uint32_t msg_ctr) {
+    payload[0] = sensor_id;
+    put_le16(payload + 1, msg_ctr);
+    payload[3] = msg_ctr >> 16;
+}
+
+// jeden pruchod smyckou main.c s nastavenymi flags
+static void sensor_wake(load_t *l, vsensor_t *s, uint8_t flags, uint64_t wake_ns) {
+    uint8_t payload[SENSORMSG_MAX_LEN];
+    double t = wake_ns;
+
+    uint8_t alert = flags & FLAG_PIR;
+    if (alert) {
+        ctr_header(payload, s->id, s->msg_ctr);
+        ctr_header(payload + SENSORMSG_CTR_HEADER_LEN, s->id, s->msg_ctr);
+        payload[2 * SENSORMSG_CTR_HEADER_LEN] = alert;
+        sensormsg_ctr_xor(payload + SENSORMSG_CTR_HEADER_LEN, SENSORMSG_ALERT_LEN, s->id, s->msg_ctr,
+                          SENSORMSG_DOMAIN_ALERT);
+        t = send_frame(l, s, payload, SENSORMSG_CTR_ALERT_LEN, t + KEYSTREAM_BLOCK_NS * s->clock);
+        add_message(l, s, s->msg_ctr, SENSORMSG_ALERT, wake_ns);
+    }
+
+    int telemetry_due = l->telemetry_every && s->telemetry_countdown == 1;
+    int blocks = SENSORMSG_REPORT_LEN / 8 + (telemetry_due ? SENSORMSG_TELEMETRY_LEN / 8 : 0);
+    t += (blocks * KEYSTREAM_BLOCK_NS + SENSOR_WAIT_NS + MEASURE_NS) * s->clock;
+
+    // message_t z main.c
+    uint8_t *m = payload + SENSORMSG_CTR_HEADER_LEN;
+    ctr_header(payload, s->id, s->msg_ctr);
+    m[0] = s->id;
+    put_le16(m + 1, s->msg_ctr);
+    put_le32(m + 3, s->tick);
+    put_le16(m + 7, 2900 + rng_next(&s->rng) % 200);
+    m[9] = flags;
+    m[10] = FW_VERSION;
+    put_le32(m + 11, (uint32_t)(400 + rng_next(&s->rng) % 300) << 16 | (200 + rng_next(&s->rng) % 50));
+    m[15] = 0;
+    sensormsg_ctr_xor(m, SENSORMSG_REPORT_LEN, s->id, s->msg_ctr, SENSORMSG_DOMAIN_MESSAGE);
+    t = send_twice(l, s, payload, SENSORMSG_CTR_REPORT_LEN, t);
+    add_message(l, s, s->msg_ctr, SENSORMSG_REPORT, wake_ns);
+    s->msg_ctr = (s->msg_ctr + 1) & 0xFFFFFF;
+
+    if (flags & FLAG_WDT && l->telemetry_every && --s->telemetry_countdown == 0) {
+        s->telemetry_countdown = l->telemetry_every;
+
+        // telemetry_t z telemetry.h - aktivni casy jen priblizne
+        memset(payload, 0, sizeof(payload));
+        ctr_header(payload, s->id, s->msg_ctr);
+        m[0] = s->id;
+        put_le16(m + 1, s->msg_ctr);
+        m[3] = SENSORMSG_TELEMETRY_TYPE;
+        put_le16(m + 4, 40);
+        put_le16(m + 6, 25 * s->wake_wdt / l->ticks_message_wait);
+        put_le16(m + 8, 120 * s->wake_wdt / l->ticks_message_wait);
+        put_le16(m + 12, s->wake_wdt);
+        put_le16(m + 14, s->wake_pir);
+        sensormsg_ctr_xor(m, SENSORMSG_TELEMETRY_LEN, s->id, s->msg_ctr, SENSORMSG_DOMAIN_MESSAGE);
+        t = send_twice(l, s, payload, SENSORMSG_CTR_TELEMETRY_LEN, t);
+        add_message(l, s, s->msg_ctr, SENSORMSG_TELEMETRY, wake_ns);
+        s->msg_ctr = (s->msg_ctr + 1) & 0xFFFFFF;
+        s->wake_wdt = s->wake_pir = 0;
+    }
+
+    s->busy_until_ns = (uint64_t)t;
+}
+
+static void sensor_init(load_t *l, vsensor_t *s, uint8_t id) {
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    s->rng.s = (uint64_t)l->seed << 32 | id;
+    s->link.s = ~s->rng.s;
+    s->clock = 1.0 + rng_range(&s->rng, -l->clock_tolerance, l->clock_tolerance);
+    s->wdt_ns = WDT_NS * (1.0 + rng_range(&s->rng, -WDT_TOLERANCE, WDT_TOLERANCE));
+    s->msg_ctr = (uint32_t)(rng_next(&s->rng) % 65536) << 8;  // msg_ctr_start - epocha z EEPROM
+    s->telemetry_countdown = l->telemetry_every;
+    for (int r = 0; r < l->receivers; r++) {
+        if (rng_unit(&s->link) < l->coverage) s->heard |= 1 << r;
+    }
+}
+
+// provoz jednoho senzoru po dobu l->duration_ns - WDT a shluky pohybu
+static void sensor_run(load_t *l, vsensor_t *s) {
+    double motion_mean_ns = l->motion_per_hour > 0 ? 3600e9 / l->motion_per_hour : 0;
+    // senzory nastartovaly v ruznou dobu - faze WDT i heartbeatu je nahodna
+    double next_wdt = rng_range(&s->rng, 0, s->wdt_ns);
+    double next_motion = motion_mean_ns ? rng_exp(&s->rng, motion_mean_ns) : l->duration_ns;
+    int burst_left = 0;
+    s->countdown = 1 + rng_next(&s->rng) % l->ticks_message_wait;
+
+    while (1) {
+        double t = next_wdt < next_motion ? next_wdt : next_motion;
+        if (t >= l->duration_ns) break;
+        uint8_t flags = 0;
+
+        if (t == next_wdt) {
+            next_wdt += s->wdt_ns;
+            s->tick++;
+            s->wake_wdt++;
+            if (--s->countdown == 0) {
+                s->countdown = l->ticks_message_wait;
+                flags = FLAG_WDT;
+            }
+        } else {
+            if (!burst_left) burst_left = 1 + (int)rng_exp(&s->rng, BURST_TRIGGERS_MEAN - 1);
+            if (--burst_left) next_motion += rng_range(&s->rng, BURST_GAP_MIN_NS, BURST_GAP_MAX_NS);
+            else next_motion += rng_exp(&s->rng, motion_mean_ns);
+            s->wake_pir++;
+            flags = FLAG_PIR;
+        }
+
+        if (!flags) continue;
+        if (t < s->busy_until_ns) {
+            l->lost_wakes++;
+            continue;
+        }
+        sensor_wake(l, s, flags, (uint64_t)t);
+    }
+}
+
+static int trace_open(trace_out_t *t, const char *path) {
+    uint8_t buf[EDGETRACE_HEADER_LEN];
+    edgetrace_header_t header = {
+        .channel = EDGETRACE_RF,
+        .first_level = 0,
+        .resolution_hz = 1000000,
+        .time = (uint32_t)time(NULL),
+    };
+
+    t->f = fopen(path, "wb");
+    if (!t->f) {
+        perror(path);
+        return -1;
+    }
+    fwrite(buf, 1, edgetrace_write_header(&header, buf), t->f);
+    edgetrace_writer_init(&t->w, 0);
+    t->ticks = 0;
+    return 0;
+}
+
+static void trace_span(trace_out_t *t, uint8_t level, uint64_t end_ns) {
+    uint8_t buf[2 * EDGETRACE_MAX_ITEM_LEN];
+    uint64_t end = (end_ns + 500) / 1000;
+    if (!t->f || end <= t->ticks) return;
+    fwrite(buf, 1, edgetrace_writer_add(&t->w, level, end - t->ticks, buf), t->f);
+    t->ticks = end;
+}
+
+static void trace_close(trace_out_t *t) {
+    uint8_t buf[EDGETRACE_MAX_ITEM_LEN];
+    if (!t->f) return;
+    fwrite(buf, 1, edgetrace_writer_flush(&t->w, buf), t->f);
+    fclose(t->f);
+    t->f = NULL;
+}
+
+static void frame_received(void *ctx, const uint8_t *frame, size_t len, bool crc_ok, uint64_t t_ns) {
+    load_t *l = ctx;
+    uint8_t payload[SENSORMSG_MAX_LEN];
+    size_t payload_len;
+    sensormsg_t msg;
+
+    if (!crc_ok) {
+        l->crc_errors++;
+        rffusion_error(&l->fusion, l->receiver);
+        return;
+    }
+
+    const uint8_t *data = sensormsg_unframe(frame, len, &payload_len);
+    if (!data || payload_len > sizeof(payload)) {
+        l->invalid++;
+        rffusion_error(&l->fusion, l->receiver);
+        return;
+    }
+    memcpy(payload, data, payload_len);
+
+    uint32_t key;
+    switch (sensormsg_decode(payload, payload_len, &msg)) {
+        case SENSORMSG_REPORT:
+            key = rffusion_key(msg.report.sensor_id, msg.report.msg_id, RFFUSION_KIND_MESSAGE);
+            break;
+        case SENSORMSG_TELEMETRY:
+            key = rffusion_key(msg.telemetry.sensor_id, msg.telemetry.msg_id, RFFUSION_KIND_MESSAGE);
+            break;
+        case SENSORMSG_ALERT:
+            key = rffusion_key(msg.alert.sensor_id, msg.alert.msg_id, RFFUSION_KIND_ALERT);
+            break;
+        default:
+            l->invalid++;
+            rffusion_error(&l->fusion, l->receiver);
+            return;
+    }
+
+    l->frames_ok++;
+    if (l->hex && l->receiver == 0) {
+        for (size_t i = 0; i < len; i++) printf("%02X", frame[i]);
+        printf("\n");
+    }
+
+    // rffusion az po vsech prijimacich - ramce musi prijit v poradi casu
+    l->decoded = grow(l->decoded, &l->decoded_cap, l->decoded_count, sizeof(decoded_t));
+    l->decoded[l->decoded_count++] = (decoded_t){
+        .t_ns = t_ns,
+        .key = key,
+        .receiver = l->receiver,
+        .order = (uint32_t)rng_next(&l->rng),
+    };
+}
+
+static int cmp_edge(const void *a, const void *b) {
+    const edge_t *x = a, *y = b;
+    return x->t_ns < y->t_ns ? -1 : x->t_ns > y->t_ns;
+}
+
+static int cmp_decoded(const void *a, const void *b) {
+    const decoded_t *x = a, *y = b;
+    if (x->t_ns != y->t_ns) return x->t_ns < y->t_ns ? -1 : 1;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static int cmp_message(const void *a, const void *b) {
+    const message_t *x = a, *y = b;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    const uint64_t *x = a, *y = b;
+    return *x < *y ? -1 : *x > *y;
+}
+
+// hrany nosne vsech vysilani, ktera prijimac slysi
+static size_t receiver_edges(load_t *l, int receiver, edge_t **edges, size_t *cap) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < l->tx_count; i++) {
+        tx_t *tx = &l->txs[i];
+        if (!(tx->heard & 1 << receiver)) continue;
+
+        // rf_send drzi linku 500 us v 0, pak nastavuje bity
+        uint8_t level = 0;
+        for (size_t b = 0; b <= tx->nbits; b++) {
+            uint8_t bit = b < tx->nbits ? tx->bits[b / 8] >> b % 8 & 1 : 0;
+            if (bit == level) continue;
+            *edges = grow(*edges, cap, n, sizeof(edge_t));
+            (*edges)[n++] = (edge_t){
+                .t_ns = tx->start_ns + (uint64_t)((b + 1) * tx->bit_ns + 0.5),
+                .delta = bit ? 1 : -1,
+            };
+            level = bit;
+        }
+    }
+    qsort(*edges, n, sizeof(edge_t), cmp_edge);
+    return n;
+}
+
+// signal prijimace do pllrx - uroven je 1, dokud vysila aspon jeden senzor
+static void receiver_decode(load_t *l, int receiver, const edge_t *edges, size_t n, uint64_t end_ns,
+                            trace_out_t *trace) {
+    static pllrx_t rx;
+    uint64_t span_start = 0;
+    uint8_t level = 0;
+    int32_t carriers = 0;
+
+    l->receiver = receiver;
+    pllrx_init(&rx, PLLRX_RHASK, 2000, frame_received, l);
+
+    for (size_t i = 0; i < n;) {
+        uint64_t t = edges[i].t_ns;
+        while (i < n && edges[i].t_ns == t) carriers += edges[i++].delta;
+        uint8_t next = carriers > 0;
+        if (next == level) continue;
+        pllrx_feed(&rx, level, t - span_start);
+        if (trace) trace_span(trace, level, t);
+        span_start = t;
+        level = next;
+    }
+    pllrx_feed(&rx, level, end_ns - span_start);
+    if (trace) trace_span(trace, level, end_ns);
+}
+
+typedef struct {
+    uint32_t messages, delivered;
+    uint32_t sent_type[SENSORMSG_ALERT + 1], delivered_type[SENSORMSG_ALERT + 1];
+    uint32_t phantoms;          // zprava za rffusion, kterou zadny senzor neposlal - CRC8 propustilo kolizi
+    uint64_t p50, p90, p99, max;
+    double host_s;
+} result_t;
+
+static uint64_t percentile(const uint64_t *v, size_t n, int p) {
+    if (!n) return 0;
+    size_t i = (n * p + 99) / 100;
+    return v[i ? i - 1 : 0];
+}
+
+static int run(load_t *l, int sensors, result_t *res) {
+    static vsensor_t vs[MAX_SENSORS];
+    trace_out_t trace = {0};
+
+    l->msg_count = l->tx_count = l->decoded_count = 0;
+    l->airtime_ns = 0;
+    l->lost_wakes = l->frames_ok = l->crc_errors = l->invalid = 0;
+    memset(res, 0, sizeof(*res));
+
+    for (int i = 0; i < sensors; i++) {
+        sensor_init(l, &vs[i], i + 1);
+        sensor_run(l, &vs[i]);
+    }
+
+    uint64_t end_ns = (uint64_t)l->duration_ns;
+    for (size_t i = 0; i < l->tx_count; i++) {
+        uint64_t e = l->txs[i].start_ns + (uint64_t)((l->txs[i].nbits + 2) * l->txs[i].bit_ns);
+        if (e > end_ns) end_ns = e;
+    }
+    end_ns += TAIL_NS;
+
+    if (l->trace_path && trace_open(&trace, l->trace_path)) return -1;
+
+    rffusion_init(&l->fusion, RFFUSION_WINDOW_MS);
+    l->rng.s = l->seed;
+    for (int r = 0; r < l->receivers; r++) {
+        char name[RFFUSION_NAME_LEN];
+        snprintf(name, sizeof(name), "prijimac%d", r + 1);
+        rffusion_receiver(&l->fusion, name);
+    }
+
+    static edge_t *edges;
+    static size_t edges_cap;
+    clock_t host_start = clock();
+    for (int r = 0; r < l->receivers; r++) {
+        size_t n = receiver_edges(l, r, &edges, &edges_cap);
+        receiver_decode(l, r, edges, n, end_ns, r == 0 && trace.f ? &trace : NULL);
+    }
+    trace_close(&trace);
+
+    // slouceni jako socrf.c - prvni kopie kazde zpravy doruci
+    qsort(l->decoded, l->decoded_count, sizeof(decoded_t), cmp_decoded);
+    qsort(l->msgs, l->msg_count, sizeof(message_t), cmp_message);
+    for (size_t i = 0; i < l->decoded_count; i++) {
+        decoded_t *d = &l->decoded[i];
+        if (!rffusion_accept(&l->fusion, d->receiver, d->key, d->t_ns / 1000000)) continue;
+
+        message_t key = {.key = d->key};
+        message_t *m = bsearch(&key, l->msgs, l->msg_count, sizeof(message_t), cmp_message);
+        if (!m) res->phantoms++;
+        else if (!m->delivered_ns) m->delivered_ns = d->t_ns;
+    }
+    res->host_s = (double)(clock() - host_start) / CLOCKS_PER_SEC;
+
+    uint64_t *latency = malloc((l->msg_count + 1) * sizeof(uint64_t));
+    size_t n = 0;
+    for (size_t i = 0; i < l->msg_count; i++) {
+        message_t *m = &l->msgs[i];
+        res->messages++;
+        res->sent_type[m->type]++;
+        if (!m->delivered_ns) continue;
+        res->delivered++;
+        res->delivered_type[m->type]++;
+        latency[n++] = m->delivered_ns - m->wake_ns;
+    }
+    qsort(latency, n, sizeof(uint64_t), cmp_u64);
+    res->p50 = percentile(latency, n, 50);
+    res->p90 = percentile(latency, n, 90);
+    res->p99 = percentile(latency, n, 99);
+    res->max = n ? latency[n - 1] : 0;
+    free(latency);
+    return 0;
+}
+
+static double loss_pct(uint32_t sent, uint32_t delivered) {
+    return sent ? 100.0 * (sent - delivered) / sent : 0.0;
+}
+
+static void print_header(void) {
+    printf("%4s %10s %8s %7s %7s %8s %8s %6s %7s %7s %7s %7s\n", "N", "vysilani/s", "zatizeni", "zpravy",
+           "ztraty", "poplachy", "ramce/s", "CRC", "p50 ms", "p90 ms", "p99 ms", "xRT");
+}
+
+static void print_row(const load_t *l, int sensors, const result_t *r) {
+    double duration_s = l->duration_ns / 1e9;
+    printf("%4d %10.2f %7.1f%% %7u %6.2f%% %7.2f%% %8.2f %6u %7.0f %7.0f %7.0f %7.0f\n", sensors,
+           l->tx_count / duration_s, 100.0 * l->airtime_ns / l->duration_ns, r->messages,
+           loss_pct(r->messages, r->delivered), loss_pct(r->sent_type[SENSORMSG_ALERT], r->delivered_type[SENSORMSG_ALERT]),
+           l->frames_ok / duration_s, l->crc_errors, r->p50 / 1e6, r->p90 / 1e6, r->p99 / 1e6,
+           r->host_s > 0 ? duration_s / r->host_s : 0);
+}
+
+// podrobnosti jednoho behu - jako print_stats v rfhub
+static void print_details(const load_t *l, const result_t *r) {
+    const rffusion_t *f = &l->fusion;
+
+    printf("\nvysilani             : %zu ramcu, %u probuzeni behem vysilani zahozeno\n", l->tx_count, l->lost_wakes);
+    printf("prijem               : %u OK, %u chybne CRC, %u neplatnych zprav, %u podvrzenych za rffusion\n",
+           l->frames_ok, l->crc_errors, l->invalid, r->phantoms);
+    printf("dorucene zpravy      : hlaseni %u z %u, poplachy %u z %u, telemetrie %u z %u\n",
+           r->delivered_type[SENSORMSG_REPORT], r->sent_type[SENSORMSG_REPORT],
+           r->delivered_type[SENSORMSG_ALERT], r->sent_type[SENSORMSG_ALERT],
+           r->delivered_type[SENSORMSG_TELEMETRY], r->sent_type[SENSORMSG_TELEMETRY]);
+    printf("zpozdeni             : p50 %.0f ms, p90 %.0f ms, p99 %.0f ms, nejvyse %.0f ms\n",
+           r->p50 / 1e6, r->p90 / 1e6, r->p99 / 1e6, r->max / 1e6);
+    printf("%-24s %8s %8s %8s %8s %7s\n", "prijimac", "ramce", "prvni", "kopie", "chyby", "prinos");
+    for (int i = 0; i < RFFUSION_RECEIVERS; i++) {
+        const rffusion_receiver_t *rx = &f->receivers[i];
+        if (!rx->used) continue;
+        printf("%-24s %8u %8u %8u %8u %6.1f%%\n", rx->name, rx->frames, rx->first, rx->duplicates, rx->errors,
+               f->unique ? 100.0 * rx->first / f->unique : 0.0);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "pouziti: %s [-n N,N,...] [-t s] [-w ticks] [-k N] [-m pohybu/h] [-c 4b6b|nrz] [-r prijimacu]\n"
+            "          [-l %%] [-e %%] [-p ppm] [-s seed] [-T rf.edg] [-x]\n"
+            "  -n  pocty senzoru (vychozi 10,20,50,100,200, nejvyse %d)\n"
+            "  -t  simulovana doba v s (vychozi 3600)\n"
+            "  -w  settings.ticks_message_wait - heartbeat po N probuzenich WDT (vychozi 50)\n"
+            "  -k  settings.telemetry_every - telemetrie po N-tem heartbeatu (vychozi 0 - vypnuto)\n"
+            "  -m  pohybu za hodinu na senzor, kazdy je shluk spusteni PIR (vychozi 6)\n"
+            "  -c  kodovani RF - settings.rf_line_code (vychozi 4b6b)\n"
+            "  -r  pocet prijimacu (vychozi 1, nejvyse %d)\n"
+            "  -l  pravdepodobnost, ze prijimac slysi senzor (vychozi 100 %%)\n"
+            "  -e  ztrata ramce na prijimaci mimo kolize (vychozi 0 %%)\n"
+            "  -p  odchylka RC oscilatoru senzoru nejvyse +-ppm (vychozi 10000)\n"
+            "  -s  seed - stejny seed, stejny provoz\n"
+            "  -T  ulozit signal prvniho prijimace (edgetrace.h, pro edgereplay) - jen pro jedno N\n"
+            "  -x  jen ramce prvniho prijimace v hex po radcich - vstup pro port 9994 brany nebo rfhub\n",
+            name, MAX_SENSORS, MAX_RECEIVERS);
+}
+
+int main(int argc, char **argv) {
+    static load_t load = {
+        .seed = 1,
+        .duration_ns = 3600e9,
+        .ticks_message_wait = 50,
+        .motion_per_hour = 6,
+        .receivers = 1,
+        .coverage = 1.0,
+        .clock_tolerance = 0.01,
+    };
+    int counts[MAX_RUNS] = {10, 20, 50, 100, 200};
+    int runs = 5, opt;
+
+    while ((opt = getopt(argc, argv, "n:t:w:k:m:c:r:l:e:p:s:T:xh")) != -1) {
+        switch (opt) {
+            case 'n': {
+                char *p = optarg;
+                for (runs = 0; runs < MAX_RUNS && *p; runs++) {
+                    counts[runs] = strtol(p, &p, 10);
+                    if (*p == ',') p++;
+                }
+                break;
+            }
+            case 't': load.duration_ns = atof(optarg) * 1e9; break;
+            case 'w': load.ticks_message_wait = atoi(optarg); break;
+            case 'k': load.telemetry_every = atoi(optarg); break;
+            case 'm': load.motion_per_hour = atof(optarg); break;
+            case 'c': load.nrz = !strcmp(optarg, "nrz"); break;
+            case 'r': load.receivers = atoi(optarg); break;
+            case 'l': load.coverage = atof(optarg) / 100; break;
+            case 'e': load.frame_loss = atof(optarg) / 100; break;
+            case 'p': load.clock_tolerance = atof(optarg) / 1e6; break;
+            case 's': load.seed = strtoul(optarg, NULL, 0); break;
+            case 'T': load.trace_path = optarg; break;
+            case 'x': load.hex = 1; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    int bad = !runs || load.duration_ns <= 0 || !load.ticks_message_wait || load.receivers < 1 ||
+              load.receivers > MAX_RECEIVERS;
+    for (int i = 0; i < runs; i++) bad |= counts[i] < 1 || counts[i] > MAX_SENSORS;
+    if (bad || ((load.trace_path || load.hex) && runs != 1)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!load.hex) {
+        printf("senzory              : heartbeat %.0f s, %.1f pohybu/h, telemetrie %s, RF %s, %d prijimac(u), %.0f s\n",
+               load.ticks_message_wait * WDT_NS / 1e9, load.motion_per_hour,
+               load.telemetry_every ? "ano" : "ne", load.nrz ? "NRZ" : "4b6b", load.receivers,
+               load.duration_ns / 1e9);
+        print_header();
+    }
+
+    result_t res;
+    for (int i = 0; i < runs; i++) {
+        if (run(&load, counts[i], &res)) return 1;
+        if (load.hex) continue;
+        print_row(&load, counts[i], &res);
+        fflush(stdout);
+    }
+
+    if (runs == 1 && !load.hex) print_details(&load, &res);
+    return 0;
+}